@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <math.h>
+#include <random>
+
+#include "Atl24Synthetic.h"
+
+using ATL24::photon::Photon;
+
+/******************************************************************************
+ * METHODS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * defaults - shallow sloping shelf with moderate noise
+ *----------------------------------------------------------------------------*/
+Atl24Synthetic::parms_t Atl24Synthetic::defaults (size_t num_photons)
+{
+    const parms_t parms = {
+        .num_photons = num_photons,
+        .surface_h = 0.0,
+        .wave_height = 0.15,
+        .start_depth = 1.0,
+        .slope = 0.005,
+        .max_depth = 30.0,
+        .kd = 0.08,
+        .noise_fraction = 0.3,
+        .geoid = -20.0,
+        .spot = 1,
+        .seed = 24
+    };
+    return parms;
+}
+
+/*----------------------------------------------------------------------------
+ * generate - photons ordered along-track with their true classification
+ *
+ *  each shot returns a handful of photons split between the sea surface, the
+ *  seafloor (thinned with depth) and uniformly distributed background noise
+ *----------------------------------------------------------------------------*/
+void Atl24Synthetic::generate (const parms_t& parms, std::vector<Photon>& p, std::vector<int>& truth)
+{
+    static const size_t PHOTONS_PER_SHOT = 4;
+    static const double START_LAT = 24.5;
+    static const double START_LON = -81.5;
+    static const double START_GPS = 1415000000.0;
+    static const double NOISE_ABOVE = 30.0;
+    static const double NOISE_BELOW = 20.0;
+    static const double SEAFLOOR_SPREAD = 0.3;
+
+    std::mt19937_64 rng(parms.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    p.resize(parms.num_photons);
+    truth.resize(parms.num_photons);
+
+    for(size_t i = 0; i < parms.num_photons; i++)
+    {
+        const size_t shot = i / PHOTONS_PER_SHOT;
+        const double x_atc = shot * SHOT_SPACING;
+        const double depth = parms.start_depth + (parms.slope * x_atc);
+
+        double ortho_h;
+        int class_ph;
+        if(uniform(rng) < parms.noise_fraction)
+        {
+            ortho_h = parms.surface_h - parms.max_depth - NOISE_BELOW + (uniform(rng) * (parms.max_depth + NOISE_BELOW + NOISE_ABOVE));
+            class_ph = OTHER;
+        }
+        else if(depth < parms.max_depth && uniform(rng) < 0.5 * exp(-2.0 * parms.kd * depth))
+        {
+            ortho_h = parms.surface_h - depth + (normal(rng) * SEAFLOOR_SPREAD);
+            class_ph = BATHYMETRY;
+        }
+        else
+        {
+            ortho_h = parms.surface_h + (normal(rng) * parms.wave_height);
+            class_ph = SEA_SURFACE;
+        }
+
+        p[i].gps_seconds    = START_GPS + (shot * SHOT_PERIOD);
+        p[i].lat_ph         = START_LAT + (x_atc / METERS_PER_DEGREE);
+        p[i].lon_ph         = START_LON;
+        p[i].x_atc          = x_atc;
+        p[i].h_ph           = ortho_h + parms.geoid;
+        p[i].geoid          = ortho_h;
+        p[i].quality_ph     = 0;
+        p[i].spot           = parms.spot;
+        truth[i]            = class_ph;
+    }
+}
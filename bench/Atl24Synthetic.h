@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __atl24_synthetic__
+#define __atl24_synthetic__
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <stdint.h>
+#include <vector>
+
+#include "photon.h" // ATL24
+
+/******************************************************************************
+ * CLASS
+ ******************************************************************************/
+
+class Atl24Synthetic
+{
+    public:
+
+        /*--------------------------------------------------------------------
+         * Constants
+         *--------------------------------------------------------------------*/
+
+        static const int OTHER = 1;         // matches ATL24 classification values
+        static const int BATHYMETRY = 40;
+        static const int SEA_SURFACE = 41;
+
+        /*--------------------------------------------------------------------
+         * Typedefs
+         *--------------------------------------------------------------------*/
+
+        typedef struct {
+            size_t      num_photons;        // total photons in beam
+            double      surface_h;          // orthometric height of sea surface (m)
+            double      wave_height;        // standard deviation of sea surface (m)
+            double      start_depth;        // depth of seafloor at start of beam (m)
+            double      slope;              // seafloor depth gained per meter along-track
+            double      max_depth;          // seafloor is not returned below this depth (m)
+            double      kd;                 // attenuation used to thin out deep returns (1/m)
+            double      noise_fraction;     // fraction of photons that are uniformly distributed noise
+            double      geoid;              // ellipsoid height of geoid (m)
+            int         spot;               // 1 - 6
+            uint64_t    seed;
+        } parms_t;
+
+        /*--------------------------------------------------------------------
+         * Methods
+         *--------------------------------------------------------------------*/
+
+        static parms_t  defaults    (size_t num_photons);
+        static void     generate    (const parms_t& parms, std::vector<ATL24::photon::Photon>& p, std::vector<int>& truth);
+
+    private:
+
+        /*--------------------------------------------------------------------
+         * Data
+         *--------------------------------------------------------------------*/
+
+        static constexpr double SHOT_SPACING = 0.7;     // meters along-track between laser shots
+        static constexpr double SHOT_PERIOD = 0.0001;   // seconds between laser shots (10kHz)
+        static constexpr double METERS_PER_DEGREE = 111320.0;
+};
+
+#endif  /* __atl24_synthetic__ */
@@ -0,0 +1,953 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "photon.h" // ATL24
+#include "cleanup.h" // ATL24
+
+#include "OsApi.h"
+#include "TimeLib.h"
+#include "FieldColumn.h"
+#include "HdfLib.h"
+#include "Atl24Columns.h"
+#include "Atl24Runner.h"
+#include "Atl24Uncertainty.h"
+#include "Atl24Capture.h"
+#include "Atl24Arena.h"
+#include "Atl24Synthetic.h"
+#include "Atl24Compression.h"
+
+using ATL24::photon::Photon;
+using std::vector;
+using std::string;
+
+/******************************************************************************
+ * LOCAL DATA
+ ******************************************************************************/
+
+static const char* DEFAULT_SIZES = "10000,100000,1000000";
+static const char* DEFAULT_OUTPUT_DIR = "/tmp";
+static const double SOAK_REPORT_INTERVAL = 10.0; // seconds between resident set samples
+static const double CHUNK_LABEL_TOLERANCE = 0.001; // fraction of photons whose chunked label may differ from a single pass
+
+/******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * reset_peak_rss - restart the kernel's resident set high water mark
+ *----------------------------------------------------------------------------*/
+static void reset_peak_rss (void)
+{
+    FILE* fp = fopen("/proc/self/clear_refs", "w");
+    if(fp)
+    {
+        fputs("5", fp);
+        fclose(fp);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * status_mb - memory field of the process status in megabytes
+ *----------------------------------------------------------------------------*/
+static double status_mb (const char* field)
+{
+    double mb = 0.0;
+    const size_t field_len = strlen(field);
+    FILE* fp = fopen("/proc/self/status", "r");
+    if(fp)
+    {
+        char line[256];
+        while(fgets(line, sizeof(line), fp))
+        {
+            long kb;
+            if(strncmp(line, field, field_len) == 0 && line[field_len] == ':' && sscanf(line + field_len + 1, "%ld kB", &kb) == 1)
+            {
+                mb = kb / 1024.0;
+                break;
+            }
+        }
+        fclose(fp);
+    }
+    return mb;
+}
+
+/*----------------------------------------------------------------------------
+ * peak_rss - resident set high water mark in megabytes
+ *----------------------------------------------------------------------------*/
+static double peak_rss (void)
+{
+    return status_mb("VmHWM");
+}
+
+/*----------------------------------------------------------------------------
+ * current_rss - resident set in megabytes
+ *----------------------------------------------------------------------------*/
+static double current_rss (void)
+{
+    return status_mb("VmRSS");
+}
+
+/*----------------------------------------------------------------------------
+ * report - one line per stage
+ *----------------------------------------------------------------------------*/
+static void report (size_t num_photons, const char* stage, double seconds, double rss)
+{
+    const double rate = seconds > 0.0 ? num_photons / seconds : 0.0;
+    printf("%10lu  %-24s %10.4lf s %14.0lf ph/s %10.1lf MB\n", num_photons, stage, seconds, rate, rss);
+    fflush(stdout);
+}
+
+/*----------------------------------------------------------------------------
+ * uncertainty_reference - per-photon formulation of the uncertainty kernel
+ *----------------------------------------------------------------------------*/
+static void uncertainty_reference (const Atl24Uncertainty::batch_t& batch, long n, float* tvu, float* thu)
+{
+    for(long k = 0; k < n; k++)
+    {
+        const double depth = batch.depth[k];
+        double transport_uncertainty = 0.0;
+        double signal_uncertainty = 0.0;
+        double subaqueous_horizontal_uncertainty = 0.0;
+        if(depth > 0.0)
+        {
+            transport_uncertainty = sqrt((batch.transport_a[k] * batch.transport_a[k]) + ((batch.transport_b[k] * depth) * (batch.transport_b[k] * depth)));
+            double signal_to_noise = (batch.snr_a[k] * (depth * depth)) + (batch.snr_b[k] * depth) + batch.snr_c[k];
+            if(signal_to_noise < 1) signal_to_noise = 1;
+            signal_uncertainty = 0.071 / sqrt(2 * signal_to_noise);
+            subaqueous_horizontal_uncertainty = 0.577 * (batch.thu_a[k] + (batch.thu_b[k] * depth));
+        }
+        const double sigma_h = batch.sigma_h[k];
+        const double sigma_across = batch.sigma_across[k];
+        const double sigma_along = batch.sigma_along[k];
+        tvu[k] = static_cast<float>(sqrt((sigma_h * sigma_h) + (transport_uncertainty * transport_uncertainty) + (signal_uncertainty * signal_uncertainty)));
+        thu[k] = static_cast<float>(sqrt((sigma_across * sigma_across) + (sigma_along * sigma_along) + (subaqueous_horizontal_uncertainty * subaqueous_horizontal_uncertainty)));
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * fill_batch - plausible lookup table coefficients and photon inputs
+ *----------------------------------------------------------------------------*/
+static void fill_batch (Atl24Uncertainty::batch_t& batch, const vector<Photon>& p, size_t start, long n, std::mt19937_64& rng)
+{
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for(long k = 0; k < n; k++)
+    {
+        const Photon& photon = p[start + k];
+        batch.snr_a[k] = -0.01 * uniform(rng);
+        batch.snr_b[k] = -1.0 * uniform(rng);
+        batch.snr_c[k] = 10.0 + (40.0 * uniform(rng));
+        batch.thu_a[k] = 0.1 * uniform(rng);
+        batch.thu_b[k] = 0.05 * uniform(rng);
+        batch.transport_a[k] = 0.1 * uniform(rng);
+        batch.transport_b[k] = 0.02 * uniform(rng);
+        batch.depth[k] = static_cast<float>(-photon.geoid); // sea surface is at zero
+        batch.sigma_h[k] = static_cast<float>(0.1 + (0.1 * uniform(rng)));
+        batch.sigma_along[k] = static_cast<float>(2.0 + uniform(rng));
+        batch.sigma_across[k] = static_cast<float>(2.0 + uniform(rng));
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * uncertainty - table lookup and kernel over a beam as Atl24Uncertainty does
+ *----------------------------------------------------------------------------*/
+static long uncertainty (const vector<float>& depth, const vector<float>& ref_el, const vector<float>& surface_roughness, const vector<float>& kd,
+                         const vector<float>& sigma_h, const vector<float>& sigma_along, const vector<float>& sigma_across,
+                         bool fast_path, vector<float>& tvu, vector<float>& thu)
+{
+    const long num_rows = static_cast<long>(depth.size());
+    Atl24Uncertainty::batch_t* batch = new Atl24Uncertainty::batch_t;
+    long slot[Atl24Uncertainty::BATCH_SIZE];
+    float batch_tvu[Atl24Uncertainty::BATCH_SIZE];
+    float batch_thu[Atl24Uncertainty::BATCH_SIZE];
+    long num_fast = 0;
+
+    tvu.resize(num_rows);
+    thu.resize(num_rows);
+    for(long start = 0; start < num_rows; start += Atl24Uncertainty::BATCH_SIZE)
+    {
+        const long n = MIN(Atl24Uncertainty::BATCH_SIZE, num_rows - start);
+        long m = 0;
+        for(long k = 0, i = start; k < n; k++, i++)
+        {
+            if(fast_path && !(depth[i] > 0.0))
+            {
+                Atl24Uncertainty::surface(sigma_h[i], sigma_along[i], sigma_across[i], tvu[i], thu[i]);
+                num_fast++;
+                continue;
+            }
+            Atl24Uncertainty::lookup(*batch, m, ref_el[i], surface_roughness[i], kd[i]);
+            batch->depth[m] = depth[i];
+            batch->sigma_h[m] = sigma_h[i];
+            batch->sigma_along[m] = sigma_along[i];
+            batch->sigma_across[m] = sigma_across[i];
+            slot[m++] = i;
+        }
+        Atl24Uncertainty::kernel(*batch, m, batch_tvu, batch_thu);
+        for(long j = 0; j < m; j++)
+        {
+            tvu[slot[j]] = batch_tvu[j];
+            thu[slot[j]] = batch_thu[j];
+        }
+    }
+
+    delete batch;
+    return num_fast;
+}
+
+/*----------------------------------------------------------------------------
+ * add_dataset - stage a copy of a column for the hdf5 writer
+ *----------------------------------------------------------------------------*/
+template<class T>
+static void add_dataset (List<HdfLib::dataset_t>& datasets, const char* name, RecordObject::fieldType_t type, const vector<T>& values)
+{
+    const long size = values.size() * sizeof(T);
+    uint8_t* buffer = new uint8_t[size];
+    memcpy(buffer, values.data(), size);
+    HdfLib::dataset_t variable = {name, HdfLib::VARIABLE, type, buffer, size};
+    datasets.add(variable);
+    HdfLib::dataset_t parent = {NULL, HdfLib::PARENT, RecordObject::INVALID_FIELD, NULL, 0};
+    datasets.add(parent);
+}
+
+/*----------------------------------------------------------------------------
+ * size_results - results sized for a beam
+ *----------------------------------------------------------------------------*/
+static void size_results (Atl24Runner::results_t& results, size_t num_photons)
+{
+    results.class_ph.resize(num_photons);
+    results.confidence.resize(num_photons);
+    results.surface_h.resize(num_photons);
+    results.kd.resize(num_photons);
+    results.surface_roughness.resize(num_photons);
+}
+
+/*----------------------------------------------------------------------------
+ * classifier - runner stages on a beam, reporting each one
+ *----------------------------------------------------------------------------*/
+static bool classifier (vector<Photon>& p, const char* model_filename, Atl24Runner::results_t& results)
+{
+    const size_t num_photons = p.size();
+    try
+    {
+        reset_peak_rss();
+        const double start = TimeLib::latchtime();
+        Atl24Runner::stage_times_t times = {0.0, 0.0, 0.0, 0.0, 0.0};
+        size_results(results, num_photons);
+        Atl24Runner::classifyPhotons(p, model_filename, results, 0, num_photons, 0, times, true);
+        const double rss = peak_rss();
+        report(num_photons, "runner: classify", times.classify, rss);
+        report(num_photons, "runner: elevations", times.elevations, rss);
+        report(num_photons, "runner: kd", times.kd, rss);
+        report(num_photons, "runner: roughness", times.roughness, rss);
+        report(num_photons, "runner: total", TimeLib::latchtime() - start, rss);
+        return true;
+    }
+    catch(const std::exception& e)
+    {
+        fprintf(stderr, "Failed to run classifier stages: %s\n", e.what());
+        return false;
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * count_mismatches - rows where two result columns are not identical
+ *----------------------------------------------------------------------------*/
+template<class T>
+static size_t count_mismatches (const vector<T>& a, const vector<T>& b)
+{
+    size_t mismatches = 0;
+    for(size_t i = 0; i < a.size(); i++)
+    {
+        if(memcmp(&a[i], &b[i], sizeof(T)) != 0) mismatches++; // bitwise, so matching NaNs agree
+    }
+    return mismatches;
+}
+
+/*----------------------------------------------------------------------------
+ * chunking - chunked classification against the single pass
+ *
+ *  the beam is split as Atl24Runner splits it, with chunk boundaries that
+ *  land part way through the beam (and so inside the sea surface and seafloor
+ *  returns) and a halo of along-track context on either side of each chunk;
+ *  every window starts from an unmodified copy of the beam's photons.  The
+ *  algorithms look at neighbouring photons, so results near a chunk edge
+ *  can differ from the single pass even with the halo: chunking is an
+ *  approximation, which is why it is off by default.  The check fails when
+ *  more than CHUNK_LABEL_TOLERANCE of the labels differ; differences in the
+ *  other columns are reported only
+ *----------------------------------------------------------------------------*/
+static bool chunking (const vector<Photon>& beam, const char* model_filename, size_t chunk_size, double chunk_halo)
+{
+    const size_t num_photons = beam.size();
+    try
+    {
+        /* Single Pass */
+        Atl24Runner::results_t single;
+        Atl24Runner::stage_times_t times = {0.0, 0.0, 0.0, 0.0, 0.0};
+        size_results(single, num_photons);
+        vector<Photon> p(beam);
+        Atl24Runner::classifyPhotons(p, model_filename, single, 0, num_photons, 0, times, false);
+
+        /* Chunked */
+        vector<double> x_atc(num_photons);
+        for(size_t i = 0; i < num_photons; i++) x_atc[i] = beam[i].x_atc;
+        vector<Atl24Runner::chunk_t> chunks;
+        if(!Atl24Runner::buildChunks(x_atc, num_photons, chunk_size, chunk_halo, chunks))
+        {
+            fprintf(stderr, "Synthetic beam is not ordered along-track\n");
+            return false;
+        }
+        Atl24Runner::results_t chunked;
+        size_results(chunked, num_photons);
+        reset_peak_rss();
+        const double start = TimeLib::latchtime();
+        for(const Atl24Runner::chunk_t& chunk: chunks)
+        {
+            vector<Photon> window(beam.begin() + chunk.window_start, beam.begin() + chunk.window_stop);
+            Atl24Runner::classifyPhotons(window, model_filename, chunked, chunk.core_start - chunk.window_start, chunk.core_stop - chunk.window_start, chunk.core_start, times, false);
+        }
+        report(num_photons, "runner: chunked", TimeLib::latchtime() - start, peak_rss());
+
+        /* Compare */
+        const size_t class_ph = count_mismatches(single.class_ph, chunked.class_ph);
+        const size_t confidence = count_mismatches(single.confidence, chunked.confidence);
+        const size_t surface_h = count_mismatches(single.surface_h, chunked.surface_h);
+        const size_t kd = count_mismatches(single.kd, chunked.kd);
+        const size_t surface_roughness = count_mismatches(single.surface_roughness, chunked.surface_roughness);
+        printf("%10lu  %-24s %lu chunks of %lu, halo %.0lf m: class_ph %lu, confidence %lu, surface_h %lu, kd %lu, roughness %lu mismatches\n",
+               num_photons, "runner: chunked vs single", chunks.size(), chunk_size, chunk_halo, class_ph, confidence, surface_h, kd, surface_roughness);
+        const double label_fraction = num_photons > 0 ? static_cast<double>(class_ph) / num_photons : 0.0;
+        if(label_fraction > CHUNK_LABEL_TOLERANCE)
+        {
+            fprintf(stderr, "Chunked classification differs from single pass in %.4lf%% of labels (tolerance %.4lf%%)\n", label_fraction * 100.0, CHUNK_LABEL_TOLERANCE * 100.0);
+            return false;
+        }
+        return true;
+    }
+    catch(const std::exception& e)
+    {
+        fprintf(stderr, "Failed to compare chunked classification: %s\n", e.what());
+        return false;
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * batching - classifying beams together must label them as classified alone
+ *
+ *  beams of different lengths and seafloors, all starting at the same
+ *  along-track distance, are classified one at a time and then in one batch
+ *  the way Atl24Runner batches the beams of a granule (concatenated, with
+ *  along-track distances shifted BATCH_GAP apart)
+ *----------------------------------------------------------------------------*/
+static bool batching (size_t num_photons, const char* model_filename, size_t num_beams)
+{
+    try
+    {
+        /* Beams */
+        vector<vector<Photon>> beams(num_beams);
+        vector<int> truth;
+        for(size_t b = 0; b < num_beams; b++)
+        {
+            Atl24Synthetic::parms_t parms = Atl24Synthetic::defaults(MAX(num_photons / (b + 1), static_cast<size_t>(1)));
+            parms.spot = static_cast<int>(b % 6) + 1;
+            parms.seed = static_cast<uint64_t>(b) + 1;
+            parms.start_depth += static_cast<double>(b) * 2.0;
+            Atl24Synthetic::generate(parms, beams[b], truth);
+        }
+
+        /* Separately */
+        vector<Atl24Runner::classification_t> single(num_beams);
+        for(size_t b = 0; b < num_beams; b++)
+        {
+            vector<Photon> p(beams[b]);
+            single[b] = Atl24Runner::classifySingle(p, model_filename);
+        }
+
+        /* Batched */
+        vector<vector<Photon>*> batch;
+        for(vector<Photon>& beam: beams) batch.push_back(&beam);
+        vector<Atl24Runner::classification_t> batched;
+        reset_peak_rss();
+        const double start = TimeLib::latchtime();
+        Atl24Runner::classifyBatch(batch, model_filename, batched);
+        report(num_photons, "runner: batched", TimeLib::latchtime() - start, peak_rss());
+
+        /* Compare */
+        bool status = true;
+        for(size_t b = 0; b < num_beams; b++)
+        {
+            const size_t labels = count_mismatches(single[b].labels, batched[b].labels);
+            const size_t bathy_prob = count_mismatches(single[b].bathy_prob, batched[b].bathy_prob);
+            printf("%10lu  %-24s beam %lu of %lu: labels %lu, bathy_prob %lu mismatches\n",
+                   beams[b].size(), "runner: batched vs single", b + 1, num_beams, labels, bathy_prob);
+            if(labels + bathy_prob > 0) status = false;
+        }
+        if(!status) fprintf(stderr, "Batched classification differs from classifying each beam separately\n");
+        return status;
+    }
+    catch(const std::exception& e)
+    {
+        fprintf(stderr, "Failed to compare batched classification: %s\n", e.what());
+        return false;
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * file_mb - size of file on disk
+ *----------------------------------------------------------------------------*/
+static double file_mb (const char* filename)
+{
+    struct stat info;
+    if(stat(filename, &info) != 0) return 0.0;
+    return info.st_size / (1024.0 * 1024.0);
+}
+
+/*----------------------------------------------------------------------------
+ * writer - stage and emit a beam group as the ATL24 writer does
+ *----------------------------------------------------------------------------*/
+static bool writer (const vector<Photon>& p, const Atl24Runner::results_t& results, const vector<float>& tvu, const vector<float>& thu, const char* filename)
+{
+    bool status = true;
+    const size_t num_photons = p.size();
+
+    vector<int8_t> class_ph(num_photons);
+    vector<double> delta_time(num_photons);
+    vector<double> lat_ph(num_photons);
+    vector<double> lon_ph(num_photons);
+    vector<float> ortho_h(num_photons);
+    for(size_t i = 0; i < num_photons; i++)
+    {
+        class_ph[i] = static_cast<int8_t>(results.class_ph[i]);
+        delta_time[i] = p[i].gps_seconds;
+        lat_ph[i] = p[i].lat_ph;
+        lon_ph[i] = p[i].lon_ph;
+        ortho_h[i] = static_cast<float>(p[i].geoid);
+    }
+
+    reset_peak_rss();
+    double start = TimeLib::latchtime();
+    List<HdfLib::dataset_t> datasets;
+    HdfLib::dataset_t group = {"gt1l", HdfLib::GROUP, RecordObject::INVALID_FIELD, NULL, 0};
+    datasets.add(group);
+    add_dataset(datasets, "class_ph", RecordObject::INT8, class_ph);
+    add_dataset(datasets, "confidence", RecordObject::FLOAT, results.confidence);
+    add_dataset(datasets, "delta_time", RecordObject::DOUBLE, delta_time);
+    add_dataset(datasets, "lat_ph", RecordObject::DOUBLE, lat_ph);
+    add_dataset(datasets, "lon_ph", RecordObject::DOUBLE, lon_ph);
+    add_dataset(datasets, "ortho_h", RecordObject::FLOAT, ortho_h);
+    add_dataset(datasets, "sigma_thu", RecordObject::FLOAT, thu);
+    add_dataset(datasets, "sigma_tvu", RecordObject::FLOAT, tvu);
+    HdfLib::dataset_t parent = {NULL, HdfLib::PARENT, RecordObject::INVALID_FIELD, NULL, 0};
+    datasets.add(parent);
+    const double stage_time = TimeLib::latchtime() - start;
+
+    start = TimeLib::latchtime();
+    if(!HdfLib::write(filename, datasets))
+    {
+        fprintf(stderr, "Failed to write %s\n", filename);
+        status = false;
+    }
+    const double write_time = TimeLib::latchtime() - start;
+    const double rss = peak_rss();
+    report(num_photons, "writer: stage", stage_time, rss);
+    report(num_photons, "writer: write", write_time, rss);
+
+    /* same datasets written with each compression setting as the writer writes them */
+    const struct {
+        const char*                 name;
+        Atl24Compression::parms_t   parms;
+    } settings[] = {
+        {"writer: chunked",         {Atl24Compression::DEFAULT_CHUNK_SIZE, false, 0, 0}},
+        {"writer: deflate=4",       {Atl24Compression::DEFAULT_CHUNK_SIZE, true, 4, 0}},
+        {"writer: zstd=3",          {Atl24Compression::DEFAULT_CHUNK_SIZE, true, 0, 3}}
+    };
+    const double contiguous_mb = file_mb(filename);
+    const string compressed_filename = string(filename) + ".compressed";
+    for(const auto& setting: settings)
+    {
+        if(!status) break;
+        reset_peak_rss();
+        start = TimeLib::latchtime();
+        if(!Atl24Compression::write(compressed_filename.c_str(), datasets, setting.parms)) continue; // zstd needs its filter plugin
+        report(num_photons, setting.name, TimeLib::latchtime() - start, peak_rss());
+        const double compressed_mb = file_mb(compressed_filename.c_str());
+        printf("%10lu  %-24s %10.1lf MB file %8.2lfx smaller\n", num_photons, setting.name, compressed_mb, compressed_mb > 0.0 ? contiguous_mb / compressed_mb : 0.0);
+        remove(compressed_filename.c_str());
+    }
+
+    for(int i = 0; i < datasets.length(); i++)
+    {
+        delete [] datasets[i].data;
+    }
+    remove(filename);
+
+    return status;
+}
+
+/*----------------------------------------------------------------------------
+ * replay - run a captured production beam through the same stages
+ *----------------------------------------------------------------------------*/
+static bool replay (const char* capture_filename, const char* model_filename, const char* output_dir)
+{
+    bool status = true;
+
+    /* Load Beam */
+    reset_peak_rss();
+    double start = TimeLib::latchtime();
+    Atl24Capture::beam_t beam;
+    if(!Atl24Capture::read(capture_filename, beam)) return false;
+    const size_t num_photons = beam.photons.size();
+    printf("replaying %s spot %d from %s\n", beam.granule.c_str(), beam.spot, capture_filename);
+    report(num_photons, "replay: load", TimeLib::latchtime() - start, peak_rss());
+
+    /* Chunked Against Single Pass (on real photons the tolerance is what is being checked) */
+    if(!chunking(beam.photons, model_filename, (num_photons / 4) + 1, Atl24Runner::DEFAULT_CHUNK_HALO)) status = false;
+
+    /* Classifier Stages */
+    Atl24Runner::results_t results;
+    if(!classifier(beam.photons, model_filename, results)) return false;
+
+    /* Uncertainty */
+    vector<float> tvu;
+    vector<float> thu;
+    {
+        vector<float> depth(num_photons);
+        for(size_t i = 0; i < num_photons; i++) depth[i] = results.surface_h[i] - beam.geoid_corr_h[i];
+        reset_peak_rss();
+        start = TimeLib::latchtime();
+        const long num_fast = uncertainty(depth, beam.ref_el, results.surface_roughness, results.kd, beam.sigma_h, beam.sigma_along, beam.sigma_across, true, tvu, thu);
+        report(num_photons, "uncertainty", TimeLib::latchtime() - start, peak_rss());
+        printf("%10lu  %-24s %10.2lf %% of photons at or above the surface\n", num_photons, "uncertainty: fast path", 100.0 * num_fast / num_photons);
+    }
+
+    /* Writer */
+    const string filename = string(output_dir) + "/atl24_replay_" + std::to_string(beam.spot) + ".h5";
+    if(!writer(beam.photons, results, tvu, thu, filename.c_str())) status = false;
+
+    return status;
+}
+
+/*----------------------------------------------------------------------------
+ * bench - run every stage on a synthetic beam of the requested size
+ *----------------------------------------------------------------------------*/
+static bool bench (size_t num_photons, const char* model_filename, const char* output_dir, bool classify)
+{
+    double start;
+    bool status = true;
+
+    /* Generate Beam */
+    reset_peak_rss();
+    start = TimeLib::latchtime();
+    vector<Photon> p;
+    vector<int> truth;
+    Atl24Synthetic::generate(Atl24Synthetic::defaults(num_photons), p, truth);
+    report(num_photons, "generate", TimeLib::latchtime() - start, peak_rss());
+
+    /* Column Allocation - default chunks */
+    {
+        reset_peak_rss();
+        start = TimeLib::latchtime();
+        FieldColumn<float> column;
+        for(size_t i = 0; i < num_photons; i++) column.append(static_cast<float>(p[i].geoid));
+        report(num_photons, "columns (default)", TimeLib::latchtime() - start, peak_rss());
+    }
+
+    /* Column Allocation - sized to beam */
+    {
+        reset_peak_rss();
+        start = TimeLib::latchtime();
+        FieldColumn<float>* column = Atl24Columns::create<float>(num_photons);
+        for(size_t i = 0; i < num_photons; i++) column->append(static_cast<float>(p[i].geoid));
+        delete column;
+        report(num_photons, "columns (sized)", TimeLib::latchtime() - start, peak_rss());
+    }
+
+    /* Column Allocation - sized to beam and copied from the algorithm output in bulk */
+    {
+        vector<float> values(num_photons);
+        for(size_t i = 0; i < num_photons; i++) values[i] = static_cast<float>(p[i].geoid);
+        reset_peak_rss();
+        start = TimeLib::latchtime();
+        FieldColumn<float>* column = Atl24Columns::create<float>(num_photons);
+        Atl24Columns::append(column, values.data(), static_cast<long>(num_photons));
+        delete column;
+        report(num_photons, "columns (bulk)", TimeLib::latchtime() - start, peak_rss());
+    }
+
+    /* Chunked Classification - four chunks so that boundaries fall inside the beam */
+    if(classify && !chunking(p, model_filename, (num_photons / 4) + 1, Atl24Runner::DEFAULT_CHUNK_HALO)) status = false;
+
+    /* Batched Classification - three beams of one granule in one classifier call */
+    if(classify && !batching(num_photons, model_filename, 3)) status = false;
+
+    /* Classifier Stages */
+    Atl24Runner::results_t results;
+    if(classify)
+    {
+        if(classifier(p, model_filename, results))
+        {
+            size_t agree = 0;
+            for(size_t i = 0; i < num_photons; i++)
+            {
+                if(results.class_ph[i] == truth[i]) agree++;
+            }
+            printf("%10lu  %-24s %10.2lf %% of photons match synthetic truth\n", num_photons, "runner: agreement", 100.0 * agree / num_photons);
+        }
+        else
+        {
+            status = false;
+        }
+    }
+    if(results.class_ph.size() != num_photons)
+    {
+        // fall back on the synthetic truth for the downstream stages
+        results.class_ph = truth;
+        results.confidence.assign(num_photons, 1.0f);
+    }
+
+    /* Uncertainty - per-photon reference */
+    vector<float> tvu(num_photons);
+    vector<float> thu(num_photons);
+    vector<float> ref_tvu(num_photons);
+    vector<float> ref_thu(num_photons);
+    {
+        Atl24Uncertainty::batch_t* batch = new Atl24Uncertainty::batch_t;
+        std::mt19937_64 rng(7);
+        double reference_time = 0.0;
+        double kernel_time = 0.0;
+        reset_peak_rss();
+        for(size_t b = 0; b < num_photons; b += Atl24Uncertainty::BATCH_SIZE)
+        {
+            const long n = MIN(Atl24Uncertainty::BATCH_SIZE, static_cast<long>(num_photons - b));
+            fill_batch(*batch, p, b, n, rng);
+            start = TimeLib::latchtime();
+            uncertainty_reference(*batch, n, &ref_tvu[b], &ref_thu[b]);
+            reference_time += TimeLib::latchtime() - start;
+            start = TimeLib::latchtime();
+            Atl24Uncertainty::kernel(*batch, n, &tvu[b], &thu[b]);
+            kernel_time += TimeLib::latchtime() - start;
+        }
+        const double rss = peak_rss();
+        report(num_photons, "uncertainty: reference", reference_time, rss);
+        report(num_photons, "uncertainty: kernel", kernel_time, rss);
+        delete batch;
+
+        size_t mismatches = 0;
+        for(size_t i = 0; i < num_photons; i++)
+        {
+            if(tvu[i] != ref_tvu[i] || thu[i] != ref_thu[i]) mismatches++;
+        }
+        if(mismatches > 0)
+        {
+            fprintf(stderr, "Uncertainty kernel differs from reference on %lu photons\n", mismatches);
+            status = false;
+        }
+    }
+
+    /* Uncertainty - fast path for photons at or above the surface */
+    {
+        std::mt19937_64 rng(11);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        vector<float> depth(num_photons);
+        vector<float> ref_el(num_photons);
+        vector<float> surface_roughness(num_photons);
+        vector<float> kd(num_photons);
+        vector<float> sigma_h(num_photons);
+        vector<float> sigma_along(num_photons);
+        vector<float> sigma_across(num_photons);
+        for(size_t i = 0; i < num_photons; i++)
+        {
+            depth[i] = static_cast<float>(-p[i].geoid); // sea surface is at zero
+            ref_el[i] = static_cast<float>(1.55 + (0.02 * uniform(rng)));
+            surface_roughness[i] = results.surface_roughness.size() == num_photons ? results.surface_roughness[i] : static_cast<float>(10.0 * uniform(rng));
+            kd[i] = results.kd.size() == num_photons ? results.kd[i] : static_cast<float>(0.4 * uniform(rng));
+            sigma_h[i] = static_cast<float>(0.1 + (0.1 * uniform(rng)));
+            sigma_along[i] = static_cast<float>(2.0 + uniform(rng));
+            sigma_across[i] = static_cast<float>(2.0 + uniform(rng));
+        }
+
+        vector<float> full_tvu;
+        vector<float> full_thu;
+        vector<float> fast_tvu;
+        vector<float> fast_thu;
+        reset_peak_rss();
+        start = TimeLib::latchtime();
+        uncertainty(depth, ref_el, surface_roughness, kd, sigma_h, sigma_along, sigma_across, false, full_tvu, full_thu);
+        report(num_photons, "uncertainty: all photons", TimeLib::latchtime() - start, peak_rss());
+        reset_peak_rss();
+        start = TimeLib::latchtime();
+        const long num_fast = uncertainty(depth, ref_el, surface_roughness, kd, sigma_h, sigma_along, sigma_across, true, fast_tvu, fast_thu);
+        report(num_photons, "uncertainty: fast path", TimeLib::latchtime() - start, peak_rss());
+        printf("%10lu  %-24s %10.2lf %% of photons at or above the surface\n", num_photons, "uncertainty: fast path", 100.0 * num_fast / num_photons);
+
+        if(memcmp(full_tvu.data(), fast_tvu.data(), num_photons * sizeof(float)) != 0 ||
+           memcmp(full_thu.data(), fast_thu.data(), num_photons * sizeof(float)) != 0)
+        {
+            fprintf(stderr, "Uncertainty fast path output differs from full calculation\n");
+            status = false;
+        }
+    }
+
+    /* Blunder Cleanup */
+    {
+        vector<Photon> q(num_photons);
+        for(size_t i = 0; i < num_photons; i++)
+        {
+            q[i].x_atc = p[i].x_atc;
+            q[i].h_ph = p[i].geoid;
+            q[i].class_ph = results.class_ph[i];
+        }
+        reset_peak_rss();
+        start = TimeLib::latchtime();
+        const ATL24::cleanup::Params params;
+        const vector<size_t> relabeled = ATL24::cleanup::do_cleanup(q, params);
+        report(num_photons, "blunder: cleanup", TimeLib::latchtime() - start, peak_rss());
+        printf("%10lu  %-24s %10lu photons relabeled\n", num_photons, "blunder: relabeled", relabeled.size());
+    }
+
+    /* Writer */
+    const string filename = string(output_dir) + "/atl24_bench_" + std::to_string(num_photons) + ".h5";
+    if(!writer(p, results, tvu, thu, filename.c_str())) status = false;
+
+    return status;
+}
+
+/*----------------------------------------------------------------------------
+ * soak - beams of varying size run back to back, sampling the resident set
+ *
+ *  mimics a long lived server working through granules: each beam draws its
+ *  buffers from an arena (or allocates them fresh when use_arena is false),
+ *  runs the classifier stages and blunder cleanup, and hands them back.  The
+ *  resident set after the first interval is the baseline; growth beyond it
+ *  over the rest of the run is reported as drift
+ *----------------------------------------------------------------------------*/
+static bool soak (double seconds, const vector<size_t>& sizes, const char* model_filename, bool classify, bool use_arena)
+{
+    bool status = true;
+    std::mt19937_64 rng(19);
+    std::uniform_real_distribution<double> jitter(0.5, 1.5);
+    vector<int> truth;
+
+    printf("soaking for %.0lf seconds %s arena
+", seconds, use_arena ? "with" : "without");
+    printf("%10s %10s %12s %12s
+", "elapsed", "beams", "photons", "rss");
+
+    const double start = TimeLib::latchtime();
+    double next_report = start + SOAK_REPORT_INTERVAL;
+    double baseline = 0.0;
+    double highest = 0.0;
+    double rss = 0.0;
+    long beams = 0;
+    long total_photons = 0;
+    while(TimeLib::latchtime() - start < seconds)
+    {
+        /* Beam Size */
+        const size_t num_photons = MAX(static_cast<size_t>(sizes[beams % sizes.size()] * jitter(rng)), static_cast<size_t>(1));
+        Atl24Synthetic::parms_t parms = Atl24Synthetic::defaults(num_photons);
+        parms.seed = static_cast<uint64_t>(beams);
+
+        /* Working Buffers */
+        Atl24Arena* arena = use_arena ? Atl24Arena::acquire(num_photons) : NULL;
+        vector<Photon> local_photons;
+        Atl24Runner::results_t local_results;
+        vector<Photon>& p = arena ? arena->photons : local_photons;
+        Atl24Runner::results_t& results = arena ? arena->results : local_results;
+
+        /* Stages */
+        Atl24Synthetic::generate(parms, p, truth);
+        try
+        {
+            if(classify)
+            {
+                Atl24Runner::stage_times_t times = {0.0, 0.0, 0.0, 0.0, 0.0};
+                size_results(results, num_photons);
+                Atl24Runner::classifyPhotons(p, model_filename, results, 0, num_photons, 0, times, true);
+            }
+            const vector<int>& class_ph = classify ? results.class_ph : truth;
+            for(size_t i = 0; i < num_photons; i++)
+            {
+                p[i].h_ph = p[i].geoid;
+                p[i].class_ph = class_ph[i];
+            }
+            const ATL24::cleanup::Params cleanup_params;
+            ATL24::cleanup::do_cleanup(p, cleanup_params);
+        }
+        catch(const std::exception& e)
+        {
+            fprintf(stderr, "Failed to run beam %ld of %lu photons: %s
+", beams, num_photons, e.what());
+            status = false;
+        }
+        if(arena) Atl24Arena::release(arena);
+        beams++;
+        total_photons += num_photons;
+        if(!status) break;
+
+        /* Sample Resident Set */
+        const double now = TimeLib::latchtime();
+        if(now >= next_report)
+        {
+            rss = current_rss();
+            if(baseline == 0.0) baseline = rss;
+            highest = MAX(highest, rss);
+            printf("%8.0lf s %10ld %12ld %9.1lf MB
+", now - start, beams, total_photons, rss);
+            fflush(stdout);
+            next_report += SOAK_REPORT_INTERVAL;
+        }
+    }
+
+    if(baseline > 0.0)
+    {
+        printf("%10ld beams: baseline %.1lf MB, final %.1lf MB, highest %.1lf MB, drift %+.1lf MB
+", beams, baseline, rss, highest, rss - baseline);
+    }
+    else
+    {
+        printf("%10ld beams: run shorter than one report interval (%.0lf seconds)
+", beams, SOAK_REPORT_INTERVAL);
+    }
+
+    return status;
+}
+
+/*----------------------------------------------------------------------------
+ * usage
+ *----------------------------------------------------------------------------*/
+static void usage (const char* name)
+{
+    printf("Usage: %s [-n <photons,...>] [-r <capture file,...>] [-m <model>] [-o <output dir>] [-t <threads>] [-s <seconds> [-A]] [-x]\n", name);
+    printf("  -n    comma separated beam sizes (default: %s)\n", DEFAULT_SIZES);
+    printf("  -r    comma separated capture files to replay instead of synthetic beams\n");
+    printf("  -m    classifier model (default: %s/atl24.tgz)\n", CONFDIR);
+    printf("  -o    directory for temporary h5 files (default: %s)\n", DEFAULT_OUTPUT_DIR);
+    printf("  -t    predictor threads, as assigned to a beam by the scheduler (default: all cpus)\n");
+    printf("  -s    soak test beams of the -n sizes back to back for this many seconds, reporting resident memory\n");
+    printf("  -A    soak test without the beam arena\n");
+    printf("  -x    skip classifier stages\n");
+}
+
+/******************************************************************************
+ * MAIN
+ ******************************************************************************/
+
+int main (int argc, char* argv[])
+{
+    string sizes(DEFAULT_SIZES);
+    string captures;
+    string model_filename = string(CONFDIR) + "/atl24.tgz";
+    string output_dir(DEFAULT_OUTPUT_DIR);
+    bool classify = true;
+    double soak_seconds = 0.0;
+    bool use_arena = true;
+
+    int opt;
+    while((opt = getopt(argc, argv, "n:r:m:o:t:s:Axh")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n':   sizes = optarg; break;
+            case 'r':   captures = optarg; break;
+            case 'm':   model_filename = optarg; break;
+            case 'o':   output_dir = optarg; break;
+            case 't':   omp_set_num_threads(MAX(atoi(optarg), 1)); break;
+            case 's':   soak_seconds = atof(optarg); break;
+            case 'A':   use_arena = false; break;
+            case 'x':   classify = false; break;
+            default:    usage(argv[0]); return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    bool status = true;
+    const string& list = captures.empty() ? sizes : captures;
+    Atl24Uncertainty::init(); // replaces compiled in lookup tables when a table image is installed
+
+    if(soak_seconds > 0.0)
+    {
+        vector<size_t> beam_sizes;
+        size_t pos = 0;
+        while(pos < sizes.size())
+        {
+            size_t end = sizes.find(',', pos);
+            if(end == string::npos) end = sizes.size();
+            const long num_photons = strtol(sizes.substr(pos, end - pos).c_str(), NULL, 0);
+            if(num_photons > 0) beam_sizes.push_back(static_cast<size_t>(num_photons));
+            pos = end + 1;
+        }
+        if(beam_sizes.empty())
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        status = soak(soak_seconds, beam_sizes, model_filename.c_str(), classify, use_arena);
+        return status ? 0 : 1;
+    }
+
+    printf("%10s  %-24s %12s %19s %13s\n", "photons", "stage", "time", "throughput", "peak rss");
+    size_t pos = 0;
+    while(pos < list.size())
+    {
+        size_t end = list.find(',', pos);
+        if(end == string::npos) end = list.size();
+        const string item = list.substr(pos, end - pos);
+        if(!captures.empty())
+        {
+            status = replay(item.c_str(), model_filename.c_str(), output_dir.c_str()) && status;
+        }
+        else
+        {
+            const long num_photons = strtol(item.c_str(), NULL, 0);
+            if(num_photons > 0)
+            {
+                status = bench(static_cast<size_t>(num_photons), model_filename.c_str(), output_dir.c_str(), classify) && status;
+            }
+        }
+        pos = end + 1;
+    }
+
+    return status ? 0 : 1;
+}
@@ -79,6 +79,24 @@ METADATA_VARIABLES = [
     "class_ph"
 ]
 
+# function - per-beam statistics written by the atl24.stats runner, None for older granules
+def stats_from_granule(h5obj):
+    try:
+        promise = h5obj.readDatasets(['metadata/stats'], block=True, enableAttributes=False)
+        return json.loads(promise['metadata/stats'])
+    except Exception:
+        return None
+
+# function - simplified granule polygon and time range, which every beam of the granule reports
+def extent_from_granule(h5obj):
+    promise = h5obj.readDatasets(['metadata/extent'], block=True, enableAttributes=False)
+    extent = json.loads(promise["metadata/extent"])
+    poly_list = extent["polygon"].split(" ")
+    coord_list = [(poly_list[i],poly_list[i+1]) for i in range(0, len(poly_list), 2)]
+    poly = Polygon(coord_list).buffer(0.01).simplify(0.01)
+    poly_str = ' '.join([f'{x[0]:.6f} {x[1]:.6f}' for x in poly.exterior.coords])
+    return {"polygon": poly_str, "begin_time": extent["begin_time"], "end_time": extent["end_time"]}
+
 # function - processing granule
 def metadata(parms):
 
@@ -91,16 +109,22 @@ def metadata(parms):
         # open granule
         h5obj = h5coro.H5Coro(path, s3driver.S3Driver, errorChecking=True, verbose=False, credentials={"role": True, "role":"iam"}, multiProcess=False)
 
+        # granule extent (atl24.stats reports the polygon and time range of each beam instead)
+        granule_extent = extent_from_granule(h5obj)
+
+        # use statistics generated by atl24.stats when the granule has them
+        beam_stats = stats_from_granule(h5obj)
+        if beam_stats is not None:
+            for beam in BEAMS:
+                if beam in beam_stats:
+                    row = dict(beam_stats[beam], beam=beam, **granule_extent)
+                    row = {key: (float("nan") if value is None else value) for key, value in row.items()}
+                    csv_lines += ','.join([f'{row[entry[0]]:{entry[1]}}' for entry in METADATA_STATS]) + "\n"
+            return csv_lines, True
+
         # read datasets
         datasets = [f'{beam}/{var}' for beam in BEAMS for var in METADATA_VARIABLES]
-        promise = h5obj.readDatasets(datasets + ['metadata/extent'], block=True, enableAttributes=False)
-        extent = json.loads(promise["metadata/extent"])
-
-        # build simplified polygon
-        poly_list = extent["polygon"].split(" ")
-        coord_list = [(poly_list[i],poly_list[i+1]) for i in range(0, len(poly_list), 2)]
-        poly = Polygon(coord_list).buffer(0.01).simplify(0.01)
-        poly_str = ' '.join([f'{x[0]:.6f} {x[1]:.6f}' for x in poly.exterior.coords])
+        promise = h5obj.readDatasets(datasets, block=True, enableAttributes=False)
 
         # process each beam in the granule
         for beam in BEAMS:
@@ -142,9 +166,7 @@ def metadata(parms):
                     "bathy_above_sea_surface": len(df_bathy[df_bathy["depth"] < 0.0]),
                     "bathy_below_sensor_depth": len(df_bathy[df_bathy["depth"] > 50.0]),
                     "histogram": hist_str,
-                    "polygon": poly_str,
-                    "begin_time": extent["begin_time"],
-                    "end_time": extent["end_time"]
+                    **granule_extent
                 }
 
                 # build csv line
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <malloc.h>
+
+#include "OsApi.h"
+#include "TimeLib.h"
+#include "LuaEngine.h"
+#include "Atl24Arena.h"
+
+/******************************************************************************
+ * DATA
+ ******************************************************************************/
+
+Mutex Atl24Arena::poolMut;
+vector<Atl24Arena*> Atl24Arena::freeArenas;
+long Atl24Arena::inUse = 0;
+long Atl24Arena::created = 0;
+long Atl24Arena::reused = 0;
+long Atl24Arena::trimmed = 0;
+Cond Atl24Arena::trimCond;
+bool Atl24Arena::trimActive = false;
+Thread* Atl24Arena::trimPid = NULL;
+
+/******************************************************************************
+ * METHODS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * init - starts the thread that frees idle arenas
+ *
+ *  a beam finishing only trims arenas that were already idle, so without
+ *  it the last arenas used before the server goes quiet would be held
+ *----------------------------------------------------------------------------*/
+void Atl24Arena::init (void)
+{
+    trimActive = true;
+    trimPid = new Thread(trimThread, NULL);
+}
+
+/*----------------------------------------------------------------------------
+ * deinit
+ *----------------------------------------------------------------------------*/
+void Atl24Arena::deinit (void)
+{
+    trimCond.lock();
+    {
+        trimActive = false;
+        trimCond.signal(0, Cond::NOTIFY_ALL);
+    }
+    trimCond.unlock();
+    delete trimPid; // joins
+    trimPid = NULL;
+    trim(0.0);
+}
+
+/*----------------------------------------------------------------------------
+ * acquire - arena for a beam of num_rows photons
+ *
+ *  the thread running a beam holds the arena until the beam is done; its
+ *  buffers keep their capacity between beams so a long running server
+ *  reuses the same few allocations instead of fragmenting the heap.  The
+ *  smallest free arena that already holds num_rows is used, otherwise
+ *  the largest one is grown; each arena therefore ends up sized by the
+ *  largest beam it has served and beams of similar size share arenas
+ *----------------------------------------------------------------------------*/
+Atl24Arena* Atl24Arena::acquire (size_t num_rows)
+{
+    Atl24Arena* arena = NULL;
+
+    poolMut.lock();
+    {
+        long best = -1;
+        for(long i = 0; i < static_cast<long>(freeArenas.size()); i++)
+        {
+            const size_t cap = freeArenas[i]->capacity();
+            if(best < 0)
+            {
+                best = i;
+                continue;
+            }
+            const size_t best_cap = freeArenas[best]->capacity();
+            const bool fits = cap >= num_rows;
+            const bool best_fits = best_cap >= num_rows;
+            if((fits && (!best_fits || cap < best_cap)) || (!fits && !best_fits && cap > best_cap))
+            {
+                best = i;
+            }
+        }
+
+        if(best >= 0)
+        {
+            arena = freeArenas[best];
+            freeArenas[best] = freeArenas.back();
+            freeArenas.pop_back();
+            reused++;
+        }
+        else
+        {
+            arena = new Atl24Arena();
+            created++;
+        }
+        inUse++;
+    }
+    poolMut.unlock();
+
+    return arena;
+}
+
+/*----------------------------------------------------------------------------
+ * release - arena is emptied but keeps its capacity for the next beam
+ *----------------------------------------------------------------------------*/
+void Atl24Arena::release (Atl24Arena* arena)
+{
+    arena->photons.clear();
+    arena->results.class_ph.clear();
+    arena->results.confidence.clear();
+    arena->results.surface_h.clear();
+    arena->results.kd.clear();
+    arena->results.surface_roughness.clear();
+    arena->lastUsed = TimeLib::latchtime();
+
+    poolMut.lock();
+    {
+        freeArenas.push_back(arena);
+        inUse--;
+    }
+    poolMut.unlock();
+
+    trim(IDLE_SECONDS);
+}
+
+/*----------------------------------------------------------------------------
+ * trim - frees arenas that have not been used for max_idle seconds
+ *
+ *  returns the number of arenas freed; the heap is handed back to the
+ *  system afterwards so resident memory drops once the server goes quiet
+ *----------------------------------------------------------------------------*/
+long Atl24Arena::trim (double max_idle)
+{
+    vector<Atl24Arena*> idle;
+    const double now = TimeLib::latchtime();
+
+    poolMut.lock();
+    {
+        for(size_t i = 0; i < freeArenas.size();)
+        {
+            if(now - freeArenas[i]->lastUsed >= max_idle)
+            {
+                idle.push_back(freeArenas[i]);
+                freeArenas[i] = freeArenas.back();
+                freeArenas.pop_back();
+            }
+            else
+            {
+                i++;
+            }
+        }
+        trimmed += idle.size();
+    }
+    poolMut.unlock();
+
+    for(Atl24Arena* arena: idle) delete arena;
+    if(!idle.empty()) malloc_trim(0);
+
+    return static_cast<long>(idle.size());
+}
+
+/*----------------------------------------------------------------------------
+ * luaStats - arena([<max idle seconds>]) --> {in_use, free, free_bytes, created, reused, trimmed}
+ *
+ *  when max idle is supplied, free arenas idle for that long are released first
+ *----------------------------------------------------------------------------*/
+int Atl24Arena::luaStats (lua_State* L)
+{
+    try
+    {
+        const double max_idle = LuaObject::getLuaFloat(L, 1, true, -1.0);
+        if(max_idle >= 0.0) trim(max_idle);
+
+        lua_newtable(L);
+        poolMut.lock();
+        {
+            int64_t free_bytes = 0;
+            for(const Atl24Arena* arena: freeArenas) free_bytes += arena->bytes();
+            LuaEngine::setAttrInt(L, "in_use", inUse);
+            LuaEngine::setAttrInt(L, "free", freeArenas.size());
+            LuaEngine::setAttrInt(L, "free_bytes", free_bytes);
+            LuaEngine::setAttrInt(L, "created", created);
+            LuaEngine::setAttrInt(L, "reused", reused);
+            LuaEngine::setAttrInt(L, "trimmed", trimmed);
+        }
+        poolMut.unlock();
+        return 1;
+    }
+    catch(const RunTimeException& e)
+    {
+        mlog(e.level(), "Error trimming arenas: %s", e.what());
+        return LuaObject::returnLuaStatus(L, false);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * Constructor
+ *----------------------------------------------------------------------------*/
+Atl24Arena::Atl24Arena (void):
+    lastUsed(0.0)
+{
+}
+
+/*----------------------------------------------------------------------------
+ * trimThread
+ *----------------------------------------------------------------------------*/
+void* Atl24Arena::trimThread (void* parm)
+{
+    (void)parm;
+
+    trimCond.lock();
+    while(trimActive)
+    {
+        trimCond.wait(0, TRIM_PERIOD_MS);
+        if(!trimActive) break;
+        trimCond.unlock();
+        {
+            trim(IDLE_SECONDS);
+        }
+        trimCond.lock();
+    }
+    trimCond.unlock();
+
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------
+ * capacity - largest beam the arena holds without growing
+ *----------------------------------------------------------------------------*/
+size_t Atl24Arena::capacity (void) const
+{
+    return MAX(photons.capacity(), results.class_ph.capacity());
+}
+
+/*----------------------------------------------------------------------------
+ * bytes - memory held by the arena's buffers
+ *----------------------------------------------------------------------------*/
+int64_t Atl24Arena::bytes (void) const
+{
+    return static_cast<int64_t>((photons.capacity() * sizeof(ATL24::photon::Photon)) +
+                                (results.class_ph.capacity() * sizeof(int)) +
+                                (results.confidence.capacity() * sizeof(float)) +
+                                (results.surface_h.capacity() * sizeof(float)) +
+                                (results.kd.capacity() * sizeof(float)) +
+                                (results.surface_roughness.capacity() * sizeof(float)));
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __atl24_arena__
+#define __atl24_arena__
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include "photon.h" // ATL24
+
+#include "OsApi.h"
+#include "LuaEngine.h"
+#include "Atl24Runner.h"
+
+/******************************************************************************
+ * CLASS
+ ******************************************************************************/
+
+class Atl24Arena
+{
+    public:
+
+        /*--------------------------------------------------------------------
+         * Constants
+         *--------------------------------------------------------------------*/
+
+        static const int IDLE_SECONDS = 60; // free arenas unused this long are released
+        static const int TRIM_PERIOD_MS = 10000; // interval at which idle arenas are checked
+
+        /*--------------------------------------------------------------------
+         * Methods
+         *--------------------------------------------------------------------*/
+
+        static void         init        (void);
+        static void         deinit      (void);
+        static Atl24Arena*  acquire     (size_t num_rows);
+        static void         release     (Atl24Arena* arena);
+        static long         trim        (double max_idle);
+        static int          luaStats    (lua_State* L);
+
+        /*--------------------------------------------------------------------
+         * Data
+         *--------------------------------------------------------------------*/
+
+        vector<ATL24::photon::Photon>   photons;
+        Atl24Runner::results_t          results;
+
+    private:
+
+        /*--------------------------------------------------------------------
+         * Methods
+         *--------------------------------------------------------------------*/
+
+                    Atl24Arena  (void);
+        static void*  trimThread  (void* parm);
+        size_t      capacity    (void) const;
+        int64_t     bytes       (void) const;
+
+        /*--------------------------------------------------------------------
+         * Data
+         *--------------------------------------------------------------------*/
+
+        double                      lastUsed;
+
+        static Mutex                poolMut;
+        static vector<Atl24Arena*>  freeArenas;
+        static long                 inUse;
+        static long                 created;
+        static long                 reused;
+        static long                 trimmed;
+
+        static Cond                 trimCond;
+        static bool                 trimActive;
+        static Thread*              trimPid;
+};
+
+#endif  /* __atl24_arena__ */
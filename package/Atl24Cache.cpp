@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "OsApi.h"
+#include "LuaObject.h"
+#include "BathyDataFrame.h"
+#include "Atl24Runner.h"
+#include "Atl24Cache.h"
+
+/******************************************************************************
+ * STATIC DATA
+ ******************************************************************************/
+
+const char* Atl24Cache::MAGIC = "ATL24RES";
+
+Mutex Atl24Cache::cacheMut;
+string Atl24Cache::directory;
+
+/******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * fnv1a - 64-bit FNV-1a hash continued from h
+ *----------------------------------------------------------------------------*/
+static uint64_t fnv1a (const void* data, size_t size, uint64_t h=0xCBF29CE484222325ULL)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for(size_t i = 0; i < size; i++)
+    {
+        h ^= bytes[i];
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+/*----------------------------------------------------------------------------
+ * hash_column - every value of a dataframe column
+ *----------------------------------------------------------------------------*/
+template<class T>
+static uint64_t hash_column (FieldColumn<T>& column, uint64_t h)
+{
+    for(long i = 0; i < column.length(); i++)
+    {
+        const T value = column[i];
+        h = fnv1a(&value, sizeof(T), h);
+    }
+    return h;
+}
+
+/*----------------------------------------------------------------------------
+ * write_values
+ *----------------------------------------------------------------------------*/
+template<class T>
+static bool write_values (FILE* file, const vector<T>& values)
+{
+    return fwrite(values.data(), sizeof(T), values.size(), file) == values.size();
+}
+
+/*----------------------------------------------------------------------------
+ * read_values
+ *----------------------------------------------------------------------------*/
+template<class T>
+static bool read_values (FILE* file, vector<T>& values, size_t num_rows)
+{
+    values.resize(num_rows);
+    return fread(values.data(), sizeof(T), num_rows, file) == num_rows;
+}
+
+/******************************************************************************
+ * METHODS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * luaCache - cache([<directory>])
+ *
+ *  classifier results are read from and written to the directory; calling
+ *  without a directory disables the cache
+ *----------------------------------------------------------------------------*/
+int Atl24Cache::luaCache (lua_State* L)
+{
+    try
+    {
+        const char* _directory = LuaObject::getLuaString(L, 1, true, NULL);
+
+        cacheMut.lock();
+        {
+            directory = _directory ? _directory : "";
+        }
+        cacheMut.unlock();
+
+        if(_directory) mlog(INFO, "Caching classifier results in %s", _directory);
+        else mlog(INFO, "Cache of classifier results disabled");
+
+        return LuaObject::returnLuaStatus(L, true);
+    }
+    catch(const RunTimeException& e)
+    {
+        mlog(e.level(), "Error configuring cache: %s", e.what());
+        return LuaObject::returnLuaStatus(L, false);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * enabled
+ *----------------------------------------------------------------------------*/
+bool Atl24Cache::enabled (void)
+{
+    bool status;
+    cacheMut.lock();
+    {
+        status = !directory.empty();
+    }
+    cacheMut.unlock();
+    return status;
+}
+
+/*----------------------------------------------------------------------------
+ * key - identifies the results of a beam
+ *
+ *  results are reused only when the granule, beam, plugin and algorithm
+ *  versions, classifier model, runner mode and the classifier input columns
+ *  themselves all match; the classifier stages run with the algorithm
+ *  library's own parameters (covered by its version), and request parameters
+ *  only matter through the photons they select, which the input columns
+ *  capture, so the request itself is not part of the key
+ *----------------------------------------------------------------------------*/
+string Atl24Cache::key (BathyDataFrame& df, const string& mode, uint64_t model_checksum)
+{
+    uint64_t input = fnv1a(NULL, 0);
+    input = hash_column(df.time_ns, input);
+    input = hash_column(df.lat_ph, input);
+    input = hash_column(df.lon_ph, input);
+    input = hash_column(df.x_atc, input);
+    input = hash_column(df.ellipse_h, input);
+    input = hash_column(df.geoid_corr_h, input);
+    input = hash_column(df.quality_ph, input);
+
+    const uint64_t mode_hash = fnv1a(mode.c_str(), mode.size());
+
+    const FString id("%s|%d|%s|%s|%016lX|%016lX|%016lX|%ld", df.granule.value.c_str(), df.spot.value, BINID, ALGOINFO,
+                     static_cast<unsigned long>(model_checksum), static_cast<unsigned long>(mode_hash), static_cast<unsigned long>(input), df.length());
+    return id.c_str();
+}
+
+/*----------------------------------------------------------------------------
+ * load - results of a previous run with the same key
+ *----------------------------------------------------------------------------*/
+bool Atl24Cache::load (BathyDataFrame& df, const string& key, Atl24Runner::results_t& results)
+{
+    const string path = filename(df, key);
+    if(path.empty()) return false;
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if(!file) return false; // not cached
+
+    /* read header */
+    char magic[8];
+    uint32_t version = 0;
+    int64_t num_rows = 0;
+    uint32_t key_len = 0;
+    bool status = fread(magic, 1, 8, file) == 8 &&
+                  fread(&version, sizeof(version), 1, file) == 1 &&
+                  fread(&num_rows, sizeof(num_rows), 1, file) == 1 &&
+                  fread(&key_len, sizeof(key_len), 1, file) == 1;
+    string stored_key;
+    if(status)
+    {
+        stored_key.resize(key_len);
+        status = fread(&stored_key[0], 1, key_len, file) == key_len;
+    }
+
+    /* check header - a different key means the file name collided */
+    if(status && (memcmp(magic, MAGIC, 8) != 0 || version != VERSION || num_rows != df.length() || stored_key != key))
+    {
+        mlog(WARNING, "Ignoring cached results for spot %d in %s, file does not match beam", df.spot.value, path.c_str());
+        fclose(file);
+        return false;
+    }
+
+    /* read columns */
+    const size_t n = static_cast<size_t>(num_rows);
+    status = status &&
+             read_values(file, results.class_ph, n) &&
+             read_values(file, results.confidence, n) &&
+             read_values(file, results.surface_h, n) &&
+             read_values(file, results.kd, n) &&
+             read_values(file, results.surface_roughness, n);
+
+    fclose(file);
+    if(status) mlog(INFO, "Loaded cached classifier results for spot %d from %s", df.spot.value, path.c_str());
+    else mlog(WARNING, "Failed to read cached results for spot %d from %s", df.spot.value, path.c_str());
+
+    return status;
+}
+
+/*----------------------------------------------------------------------------
+ * store - results written under a temporary name and renamed into place
+ *----------------------------------------------------------------------------*/
+bool Atl24Cache::store (BathyDataFrame& df, const string& key, const Atl24Runner::results_t& results)
+{
+    const string path = filename(df, key);
+    if(path.empty()) return false;
+
+    const FString tmp_path("%s.%d.tmp", path.c_str(), static_cast<int>(getpid()));
+    FILE* file = fopen(tmp_path.c_str(), "wb");
+    if(!file)
+    {
+        mlog(CRITICAL, "Failed to open cache file %s: %s", tmp_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    /* write header */
+    const uint32_t version = VERSION;
+    const int64_t num_rows = static_cast<int64_t>(results.class_ph.size());
+    const uint32_t key_len = static_cast<uint32_t>(key.size());
+    bool status = fwrite(MAGIC, 1, 8, file) == 8 &&
+                  fwrite(&version, sizeof(version), 1, file) == 1 &&
+                  fwrite(&num_rows, sizeof(num_rows), 1, file) == 1 &&
+                  fwrite(&key_len, sizeof(key_len), 1, file) == 1 &&
+                  fwrite(key.c_str(), 1, key_len, file) == key_len;
+
+    /* write columns */
+    status = status &&
+             write_values(file, results.class_ph) &&
+             write_values(file, results.confidence) &&
+             write_values(file, results.surface_h) &&
+             write_values(file, results.kd) &&
+             write_values(file, results.surface_roughness);
+
+    /* move into place */
+    if(fclose(file) != 0) status = false;
+    if(status && rename(tmp_path.c_str(), path.c_str()) != 0) status = false;
+    if(status)
+    {
+        mlog(INFO, "Cached classifier results for spot %d in %s", df.spot.value, path.c_str());
+    }
+    else
+    {
+        mlog(CRITICAL, "Failed to write cache file %s", path.c_str());
+        remove(tmp_path.c_str());
+    }
+
+    return status;
+}
+
+/*----------------------------------------------------------------------------
+ * filename - <directory>/<granule>_<spot>_<hash of key>.res
+ *----------------------------------------------------------------------------*/
+string Atl24Cache::filename (BathyDataFrame& df, const string& key)
+{
+    string dir;
+    cacheMut.lock();
+    {
+        dir = directory;
+    }
+    cacheMut.unlock();
+    if(dir.empty()) return "";
+
+    const uint64_t h = fnv1a(key.c_str(), key.size());
+    const FString path("%s/%s_%d_%016lX.res", dir.c_str(), df.granule.value.c_str(), df.spot.value, static_cast<unsigned long>(h));
+    return path.c_str();
+}
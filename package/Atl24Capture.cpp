@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "OsApi.h"
+#include "LuaObject.h"
+#include "BathyDataFrame.h"
+#include "Atl24Photons.h"
+#include "Atl24Capture.h"
+
+using ATL24::photon::Photon;
+
+/******************************************************************************
+ * STATIC DATA
+ ******************************************************************************/
+
+const char* Atl24Capture::MAGIC = "ATL24CAP";
+
+Mutex Atl24Capture::captureMut;
+string Atl24Capture::directory;
+
+/******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * write_column - one member of every photon as a contiguous array
+ *----------------------------------------------------------------------------*/
+template<class T, class F>
+static bool write_column (FILE* file, const vector<Photon>& p, F member)
+{
+    vector<T> values(p.size());
+    for(size_t i = 0; i < p.size(); i++) values[i] = static_cast<T>(member(p[i]));
+    return fwrite(values.data(), sizeof(T), values.size(), file) == values.size();
+}
+
+/*----------------------------------------------------------------------------
+ * read_column - contiguous array into one member of every photon
+ *----------------------------------------------------------------------------*/
+template<class T, class F>
+static bool read_column (FILE* file, vector<Photon>& p, F member)
+{
+    vector<T> values(p.size());
+    if(fread(values.data(), sizeof(T), values.size(), file) != values.size()) return false;
+    for(size_t i = 0; i < p.size(); i++) member(p[i], values[i]);
+    return true;
+}
+
+/*----------------------------------------------------------------------------
+ * write_float_column - dataframe column written as floats
+ *----------------------------------------------------------------------------*/
+static bool write_float_column (FILE* file, BathyDataFrame& df, const char* name)
+{
+    const long num_rows = df.length();
+    vector<float> values(num_rows, 0.0f);
+    FieldColumn<float>* column = reinterpret_cast<FieldColumn<float>*>(df.getColumn(name, true));
+    if(column)
+    {
+        for(long i = 0; i < num_rows; i++) values[i] = (*column)[i];
+    }
+    else
+    {
+        mlog(WARNING, "Captured beam is missing column %s, zeros written in its place", name);
+    }
+    return fwrite(values.data(), sizeof(float), values.size(), file) == values.size();
+}
+
+/*----------------------------------------------------------------------------
+ * read_float_column
+ *----------------------------------------------------------------------------*/
+static bool read_float_column (FILE* file, vector<float>& values, size_t num_rows)
+{
+    values.resize(num_rows);
+    return fread(values.data(), sizeof(float), num_rows, file) == num_rows;
+}
+
+/******************************************************************************
+ * METHODS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * luaCapture - capture([<directory>])
+ *
+ *  beams entering the classifier are written to the directory; calling
+ *  without a directory disables capture
+ *----------------------------------------------------------------------------*/
+int Atl24Capture::luaCapture (lua_State* L)
+{
+    try
+    {
+        const char* _directory = LuaObject::getLuaString(L, 1, true, NULL);
+
+        captureMut.lock();
+        {
+            directory = _directory ? _directory : "";
+        }
+        captureMut.unlock();
+
+        if(_directory) mlog(INFO, "Capturing classifier inputs to %s", _directory);
+        else mlog(INFO, "Capture of classifier inputs disabled");
+
+        return LuaObject::returnLuaStatus(L, true);
+    }
+    catch(const RunTimeException& e)
+    {
+        mlog(e.level(), "Error configuring capture: %s", e.what());
+        return LuaObject::returnLuaStatus(L, false);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * enabled
+ *----------------------------------------------------------------------------*/
+bool Atl24Capture::enabled (void)
+{
+    bool status;
+    captureMut.lock();
+    {
+        status = !directory.empty();
+    }
+    captureMut.unlock();
+    return status;
+}
+
+/*----------------------------------------------------------------------------
+ * write - <directory>/<granule>_<spot>.cap
+ *
+ *  layout: magic, version, spot, number of rows, granule name, then each
+ *  column as a contiguous array (photon members as doubles except for
+ *  quality_ph, followed by the float uncertainty inputs)
+ *----------------------------------------------------------------------------*/
+bool Atl24Capture::write (BathyDataFrame& df)
+{
+    string dir;
+    captureMut.lock();
+    {
+        dir = directory;
+    }
+    captureMut.unlock();
+    if(dir.empty()) return false;
+
+    /* build classifier input exactly as the runner does */
+    vector<Photon> p;
+    Atl24Photons::fromBathy(df, p);
+
+    /* open file */
+    const string& granule = df.granule.value;
+    const FString filename("%s/%s_%d.cap", dir.c_str(), granule.c_str(), df.spot.value);
+    FILE* file = fopen(filename.c_str(), "wb");
+    if(!file)
+    {
+        mlog(CRITICAL, "Failed to open capture file %s: %s", filename.c_str(), strerror(errno));
+        return false;
+    }
+
+    /* write header */
+    const uint32_t version = VERSION;
+    const int32_t spot = df.spot.value;
+    const int64_t num_rows = static_cast<int64_t>(p.size());
+    const uint32_t granule_len = static_cast<uint32_t>(granule.size());
+    bool status = fwrite(MAGIC, 1, 8, file) == 8 &&
+                  fwrite(&version, sizeof(version), 1, file) == 1 &&
+                  fwrite(&spot, sizeof(spot), 1, file) == 1 &&
+                  fwrite(&num_rows, sizeof(num_rows), 1, file) == 1 &&
+                  fwrite(&granule_len, sizeof(granule_len), 1, file) == 1 &&
+                  fwrite(granule.c_str(), 1, granule_len, file) == granule_len;
+
+    /* write columns */
+    status = status &&
+             write_column<double>(file, p, [](const Photon& ph) { return ph.gps_seconds; }) &&
+             write_column<double>(file, p, [](const Photon& ph) { return ph.lat_ph; }) &&
+             write_column<double>(file, p, [](const Photon& ph) { return ph.lon_ph; }) &&
+             write_column<double>(file, p, [](const Photon& ph) { return ph.x_atc; }) &&
+             write_column<double>(file, p, [](const Photon& ph) { return ph.h_ph; }) &&
+             write_column<double>(file, p, [](const Photon& ph) { return ph.geoid; }) &&
+             write_column<int32_t>(file, p, [](const Photon& ph) { return ph.quality_ph; }) &&
+             write_float_column(file, df, "ref_el") &&
+             write_float_column(file, df, "geoid_corr_h") &&
+             write_float_column(file, df, "sigma_h") &&
+             write_float_column(file, df, "sigma_along") &&
+             write_float_column(file, df, "sigma_across");
+
+    /* close file */
+    if(fclose(file) != 0) status = false;
+    if(status) mlog(INFO, "Captured %ld photons on spot %d to %s", static_cast<long>(num_rows), spot, filename.c_str());
+    else mlog(CRITICAL, "Failed to write capture file %s", filename.c_str());
+
+    return status;
+}
+
+/*----------------------------------------------------------------------------
+ * read
+ *----------------------------------------------------------------------------*/
+bool Atl24Capture::read (const char* filename, beam_t& beam)
+{
+    FILE* file = fopen(filename, "rb");
+    if(!file)
+    {
+        print2term("Failed to open capture file %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    /* read header */
+    char magic[8];
+    uint32_t version = 0;
+    int32_t spot = 0;
+    int64_t num_rows = 0;
+    uint32_t granule_len = 0;
+    bool status = fread(magic, 1, 8, file) == 8 &&
+                  fread(&version, sizeof(version), 1, file) == 1 &&
+                  fread(&spot, sizeof(spot), 1, file) == 1 &&
+                  fread(&num_rows, sizeof(num_rows), 1, file) == 1 &&
+                  fread(&granule_len, sizeof(granule_len), 1, file) == 1;
+    if(status && (memcmp(magic, MAGIC, 8) != 0 || version != VERSION || num_rows < 0))
+    {
+        print2term("Invalid capture file %s (version %u)\n", filename, version);
+        status = false;
+    }
+    if(status)
+    {
+        beam.granule.resize(granule_len);
+        status = fread(beam.granule.data(), 1, granule_len, file) == granule_len;
+        beam.spot = spot;
+    }
+
+    /* read columns */
+    if(status)
+    {
+        const size_t n = static_cast<size_t>(num_rows);
+        beam.photons.assign(n, Photon());
+        for(size_t i = 0; i < n; i++) beam.photons[i].spot = spot;
+        vector<Photon>& p = beam.photons;
+        status = read_column<double>(file, p, [](Photon& ph, double v) { ph.gps_seconds = v; }) &&
+                 read_column<double>(file, p, [](Photon& ph, double v) { ph.lat_ph = v; }) &&
+                 read_column<double>(file, p, [](Photon& ph, double v) { ph.lon_ph = v; }) &&
+                 read_column<double>(file, p, [](Photon& ph, double v) { ph.x_atc = v; }) &&
+                 read_column<double>(file, p, [](Photon& ph, double v) { ph.h_ph = v; }) &&
+                 read_column<double>(file, p, [](Photon& ph, double v) { ph.geoid = v; }) &&
+                 read_column<int32_t>(file, p, [](Photon& ph, int32_t v) { ph.quality_ph = v; }) &&
+                 read_float_column(file, beam.ref_el, n) &&
+                 read_float_column(file, beam.geoid_corr_h, n) &&
+                 read_float_column(file, beam.sigma_h, n) &&
+                 read_float_column(file, beam.sigma_along, n) &&
+                 read_float_column(file, beam.sigma_across, n);
+    }
+
+    /* close file */
+    fclose(file);
+    if(!status) print2term("Failed to read capture file %s\n", filename);
+
+    return status;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __atl24_columns__
+#define __atl24_columns__
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include "OsApi.h"
+#include "FieldColumn.h"
+
+/******************************************************************************
+ * CLASSES
+ ******************************************************************************/
+
+/* column created by Atl24Columns - its first capacity rows are one allocation */
+template<class T>
+class Atl24Column: public FieldColumn<T>
+{
+    public:
+
+        /*--------------------------------------------------------------------
+         * Methods
+         *--------------------------------------------------------------------*/
+
+        explicit Atl24Column (long _capacity):
+            FieldColumn<T>(0, _capacity),
+            capacity(_capacity)
+        {
+        }
+
+        /* storage of the column while every row is in its first chunk, NULL otherwise */
+        T* contiguous (void)
+        {
+            const long num_rows = this->length();
+            return (num_rows > 0 && num_rows <= capacity) ? &(*this)[0] : NULL;
+        }
+
+    private:
+
+        /*--------------------------------------------------------------------
+         * Data
+         *--------------------------------------------------------------------*/
+
+        long capacity; // chunk size the column was constructed with
+};
+
+class Atl24Columns
+{
+    public:
+
+        /*--------------------------------------------------------------------
+         * Methods
+         *--------------------------------------------------------------------*/
+
+        /* chunk size that holds the entire column in a single allocation */
+        static long chunkSize (long num_rows)
+        {
+            return num_rows > 0 ? num_rows : FieldColumn<int>::DEFAULT_CHUNK_SIZE;
+        }
+
+        /* new column whose storage is allocated once for the final row count */
+        template<class T>
+        static FieldColumn<T>* create (long num_rows)
+        {
+            return new Atl24Column<T>(chunkSize(num_rows));
+        }
+
+        /* contiguous storage of a column created above, NULL for any other column */
+        template<class T>
+        static T* contiguous (FieldColumn<T>* column)
+        {
+            Atl24Column<T>* sized = dynamic_cast<Atl24Column<T>*>(column);
+            return sized ? sized->contiguous() : NULL;
+        }
+
+        /* appends n values from an algorithm's output buffer in one bulk copy */
+        template<class T>
+        static void append (FieldColumn<T>* column, const T* values, long n)
+        {
+            if(n > 0) column->appendBuffer(reinterpret_cast<const uint8_t*>(values), n * sizeof(T));
+        }
+};
+
+#endif  /* __atl24_columns__ */
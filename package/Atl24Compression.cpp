@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <hdf5.h>
+
+#include "OsApi.h"
+#include "LuaObject.h"
+#include "TimeLib.h"
+#include "RecordObject.h"
+#include "HdfLib.h"
+#include "Atl24Compression.h"
+
+/******************************************************************************
+ * LOCAL TYPES
+ ******************************************************************************/
+
+typedef struct {
+    string          path;   // full path of dataset in file
+    const uint8_t*  data;
+    long            size;   // bytes
+} deferred_t;
+
+/******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * reclaim - frees memory the library allocated for variable length values
+ *----------------------------------------------------------------------------*/
+static void reclaim (hid_t type, hid_t space, void* buffer)
+{
+    if(H5Tdetect_class(type, H5T_VLEN) > 0 || H5Tis_variable_str(type) > 0)
+    {
+#if H5_VERSION_GE(1,12,0)
+        H5Treclaim(type, space, H5P_DEFAULT, buffer);
+#else
+        H5Dvlen_reclaim(type, space, H5P_DEFAULT, buffer);
+#endif
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * copy_attribute - H5Aiterate2 callback, copies one attribute to op_data
+ *----------------------------------------------------------------------------*/
+static herr_t copy_attribute (hid_t src, const char* name, const H5A_info_t* info, void* op_data)
+{
+    (void)info;
+    const hid_t dst = *static_cast<hid_t*>(op_data);
+    herr_t status = -1;
+
+    const hid_t attr = H5Aopen(src, name, H5P_DEFAULT);
+    if(attr < 0) return -1;
+    const hid_t type = H5Aget_type(attr);
+    const hid_t space = H5Aget_space(attr);
+    const hssize_t n = H5Sget_simple_extent_npoints(space);
+    vector<uint8_t> buffer(MAX(n, static_cast<hssize_t>(1)) * H5Tget_size(type));
+    if(H5Aread(attr, type, buffer.data()) >= 0)
+    {
+        const hid_t copy = H5Acreate2(dst, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+        if(copy >= 0)
+        {
+            if(H5Awrite(copy, type, buffer.data()) >= 0) status = 0;
+            H5Aclose(copy);
+        }
+        reclaim(type, space, buffer.data());
+    }
+    H5Sclose(space);
+    H5Tclose(type);
+    H5Aclose(attr);
+
+    return status;
+}
+
+/*----------------------------------------------------------------------------
+ * copy_attributes - every attribute of object src onto object dst
+ *----------------------------------------------------------------------------*/
+static bool copy_attributes (hid_t src, hid_t dst)
+{
+    return H5Aiterate2(src, H5_INDEX_NAME, H5_ITER_INC, NULL, copy_attribute, &dst) >= 0;
+}
+
+/*----------------------------------------------------------------------------
+ * set_layout - chunking and filters of a dataset of n elements
+ *----------------------------------------------------------------------------*/
+static bool set_layout (hid_t dcpl, hsize_t n, const Atl24Compression::parms_t& parms)
+{
+    const bool filtered = parms.shuffle || parms.deflate > 0 || parms.zstd > 0;
+    const long chunk_size = parms.chunk_size > 0 ? parms.chunk_size : (filtered ? Atl24Compression::DEFAULT_CHUNK_SIZE : 0);
+    if(chunk_size <= 0) return true;
+
+    const hsize_t chunk = MIN(static_cast<hsize_t>(chunk_size), n);
+    if(H5Pset_chunk(dcpl, 1, &chunk) < 0) return false;
+    if(parms.shuffle && H5Pset_shuffle(dcpl) < 0) return false;
+    if(parms.deflate > 0 && H5Pset_deflate(dcpl, parms.deflate) < 0) return false;
+    if(parms.zstd > 0)
+    {
+        const unsigned int level = static_cast<unsigned int>(parms.zstd);
+        if(H5Pset_filter(dcpl, Atl24Compression::ZSTD_FILTER, H5Z_FLAG_MANDATORY, 1, &level) < 0) return false;
+    }
+    return true;
+}
+
+/*----------------------------------------------------------------------------
+ * fill_dataset - replaces the empty dataset HdfLib wrote at path with one
+ *                holding the deferred values, laid out as requested
+ *
+ *  the new dataset takes its type and attributes from the empty one, so
+ *  the file matches what HdfLib would have written apart from its layout
+ *----------------------------------------------------------------------------*/
+static bool fill_dataset (hid_t file, const deferred_t& deferred, const Atl24Compression::parms_t& parms)
+{
+    bool status = false;
+    const string filled_path = deferred.path + ".filled";
+
+    const hid_t dset = H5Dopen2(file, deferred.path.c_str(), H5P_DEFAULT);
+    if(dset < 0) return false;
+    const hid_t type = H5Dget_type(dset);
+    const size_t type_size = H5Tget_size(type);
+    const hsize_t n = type_size > 0 ? static_cast<hsize_t>(deferred.size) / type_size : 0;
+    const hid_t space = H5Screate_simple(1, &n, NULL);
+    const hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+    if(n * type_size == static_cast<hsize_t>(deferred.size) && set_layout(dcpl, n, parms))
+    {
+        const hid_t filled = H5Dcreate2(file, filled_path.c_str(), type, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+        if(filled >= 0)
+        {
+            status = H5Dwrite(filled, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, deferred.data) >= 0 &&
+                     copy_attributes(dset, filled);
+            H5Dclose(filled);
+        }
+    }
+    H5Pclose(dcpl);
+    H5Sclose(space);
+    H5Tclose(type);
+    H5Dclose(dset);
+
+    /* put the filled dataset in place of the empty one */
+    if(status)
+    {
+        status = H5Ldelete(file, deferred.path.c_str(), H5P_DEFAULT) >= 0 &&
+                 H5Lmove(file, filled_path.c_str(), file, deferred.path.c_str(), H5P_DEFAULT, H5P_DEFAULT) >= 0;
+    }
+
+    return status;
+}
+
+/******************************************************************************
+ * CLASS METHODS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * fromLua - {chunk_size=<elements>, shuffle=<bool>, deflate=<1-9>, zstd=<1-22>}
+ *
+ *  anything other than a table at index leaves the file uncompressed
+ *----------------------------------------------------------------------------*/
+void Atl24Compression::fromLua (lua_State* L, int index, parms_t& parms)
+{
+    parms.chunk_size = 0;
+    parms.shuffle = false;
+    parms.deflate = 0;
+    parms.zstd = 0;
+
+    if(!lua_istable(L, index)) return;
+
+    lua_getfield(L, index, "chunk_size");
+    parms.chunk_size = LuaObject::getLuaInteger(L, -1, true, 0);
+    lua_pop(L, 1);
+
+    lua_getfield(L, index, "shuffle");
+    parms.shuffle = LuaObject::getLuaBoolean(L, -1, true, false);
+    lua_pop(L, 1);
+
+    lua_getfield(L, index, "deflate");
+    parms.deflate = static_cast<int>(LuaObject::getLuaInteger(L, -1, true, 0));
+    lua_pop(L, 1);
+
+    lua_getfield(L, index, "zstd");
+    parms.zstd = static_cast<int>(LuaObject::getLuaInteger(L, -1, true, 0));
+    lua_pop(L, 1);
+
+    if(parms.chunk_size < 0) throw RunTimeException(CRITICAL, RTE_FAILURE, "invalid chunk size: %ld", parms.chunk_size);
+    if(parms.deflate < 0 || parms.deflate > 9) throw RunTimeException(CRITICAL, RTE_FAILURE, "invalid deflate level: %d", parms.deflate);
+    if(parms.zstd < 0 || parms.zstd > 22) throw RunTimeException(CRITICAL, RTE_FAILURE, "invalid zstd level: %d", parms.zstd);
+    if(parms.deflate > 0 && parms.zstd > 0) throw RunTimeException(CRITICAL, RTE_FAILURE, "deflate and zstd compression are mutually exclusive");
+}
+
+/*----------------------------------------------------------------------------
+ * enabled
+ *----------------------------------------------------------------------------*/
+bool Atl24Compression::enabled (const parms_t& parms)
+{
+    return parms.chunk_size > 0 || parms.shuffle || parms.deflate > 0 || parms.zstd > 0;
+}
+
+/*----------------------------------------------------------------------------
+ * write - writes datasets to an HDF5 file with the requested compression
+ *
+ *  HdfLib only writes contiguous, unfiltered datasets, so when compression
+ *  is requested it is handed the datasets with every fixed size variable
+ *  emptied; that writes the groups, scalars, attributes and types of the
+ *  file as it always does, and the values of each emptied variable are
+ *  then written once, directly from the staged buffers, into a dataset
+ *  created with chunking and filters set in its creation properties.  The
+ *  values are never written uncompressed and no second file is made.  zstd
+ *  needs the filter plugin on HDF5_PLUGIN_PATH, and the write fails up
+ *  front if that plugin cannot be loaded.
+ *----------------------------------------------------------------------------*/
+bool Atl24Compression::write (const char* filename, List<HdfLib::dataset_t>& datasets, const parms_t& parms)
+{
+    if(!enabled(parms)) return HdfLib::write(filename, datasets);
+
+    if(parms.zstd > 0 && H5Zfilter_avail(ZSTD_FILTER) <= 0)
+    {
+        mlog(CRITICAL, "HDF5 filter %d (zstd) is not available, check HDF5_PLUGIN_PATH", ZSTD_FILTER);
+        return false;
+    }
+
+    const double start = TimeLib::latchtime();
+
+    /* defer values of variables */
+    List<HdfLib::dataset_t> layout;
+    vector<deferred_t> deferred;
+    vector<string> groups;
+    for(int i = 0; i < datasets.length(); i++)
+    {
+        HdfLib::dataset_t dataset = datasets[i];
+        auto& [name, type, data_type, data, size] = dataset; // positional, as the writers initialize it
+        if(type == HdfLib::GROUP)
+        {
+            groups.push_back(name);
+        }
+        else if(type == HdfLib::PARENT)
+        {
+            if(!groups.empty()) groups.pop_back();
+        }
+        else if(type == HdfLib::VARIABLE && data_type != RecordObject::STRING && data && size > 0)
+        {
+            string path;
+            for(const string& group: groups) path += "/" + group;
+            path += "/";
+            path += name;
+            deferred.push_back({path, data, size});
+            size = 0;
+        }
+        layout.add(dataset);
+    }
+
+    /* write file without the deferred values */
+    if(!HdfLib::write(filename, layout)) return false;
+
+    /* write deferred values */
+    bool status = false;
+    const hid_t file = H5Fopen(filename, H5F_ACC_RDWR, H5P_DEFAULT);
+    if(file >= 0)
+    {
+        status = true;
+        for(const deferred_t& entry: deferred)
+        {
+            if(!fill_dataset(file, entry, parms))
+            {
+                mlog(CRITICAL, "Failed to write compressed dataset %s", entry.path.c_str());
+                status = false;
+                break;
+            }
+        }
+        if(H5Fclose(file) < 0) status = false;
+    }
+
+    if(!status)
+    {
+        mlog(CRITICAL, "Failed to compress HDF5 file %s", filename);
+        remove(filename);
+        return false;
+    }
+
+    mlog(INFO, "Compressed %lu datasets of HDF5 file %s in %.3lf seconds", deferred.size(), filename, TimeLib::latchtime() - start);
+    return true;
+}
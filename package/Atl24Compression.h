@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __atl24_compression__
+#define __atl24_compression__
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include "OsApi.h"
+#include "List.h"
+#include "LuaEngine.h"
+#include "HdfLib.h"
+
+/******************************************************************************
+ * CLASS
+ ******************************************************************************/
+
+class Atl24Compression
+{
+    public:
+
+        /*--------------------------------------------------------------------
+         * Constants
+         *--------------------------------------------------------------------*/
+
+        static const long   DEFAULT_CHUNK_SIZE = 100000; // elements per chunk when filters are requested without a chunk size
+        static const int    ZSTD_FILTER = 32015; // registered HDF5 filter id of zstd (loaded from HDF5_PLUGIN_PATH)
+
+        /*--------------------------------------------------------------------
+         * Typedefs
+         *--------------------------------------------------------------------*/
+
+        typedef struct {
+            long    chunk_size;     // elements per dataset chunk, 0 leaves datasets contiguous
+            bool    shuffle;        // byte shuffle filter ahead of compression
+            int     deflate;        // gzip level 1-9, 0 disables
+            int     zstd;           // zstd level 1-22, 0 disables
+        } parms_t;
+
+        /*--------------------------------------------------------------------
+         * Methods
+         *--------------------------------------------------------------------*/
+
+        static void     fromLua     (lua_State* L, int index, parms_t& parms);
+        static bool     enabled     (const parms_t& parms);
+        static bool     write       (const char* filename, List<HdfLib::dataset_t>& datasets, const parms_t& parms);
+};
+
+#endif  /* __atl24_compression__ */
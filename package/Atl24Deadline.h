@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __atl24_deadline__
+#define __atl24_deadline__
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <atomic>
+
+#include "OsApi.h"
+#include "TimeLib.h"
+
+/******************************************************************************
+ * CLASS
+ ******************************************************************************/
+
+class Atl24Deadline
+{
+    public:
+
+        /*--------------------------------------------------------------------
+         * Constants
+         *--------------------------------------------------------------------*/
+
+        static const int POLL_MS = 1000; // longest a blocked wait goes without checking for cancellation
+
+        /*--------------------------------------------------------------------
+         * Methods
+         *--------------------------------------------------------------------*/
+
+        Atl24Deadline (void): expiration(0.0), cancelled(false) {}
+
+        /* work still running timeout_ms from now is cancelled, a negative timeout clears the deadline */
+        void set (long timeout_ms)
+        {
+            expiration = timeout_ms >= 0 ? TimeLib::latchtime() + (timeout_ms / 1000.0) : 0.0;
+            cancelled = false;
+        }
+
+        /* cancels work in progress and any started later, until the deadline is set again */
+        void cancel (void)
+        {
+            cancelled = true;
+        }
+
+        bool expired (void) const
+        {
+            if(cancelled) return true;
+            const double e = expiration;
+            return e > 0.0 && TimeLib::latchtime() >= e;
+        }
+
+        /* called between stages of work - abandons the work once it is no longer wanted */
+        void check (const char* stage) const
+        {
+            if(expired())
+            {
+                throw RunTimeException(WARNING, RTE_TIMEOUT, "cancelled before %s", stage);
+            }
+        }
+
+    private:
+
+        /*--------------------------------------------------------------------
+         * Data
+         *--------------------------------------------------------------------*/
+
+        std::atomic<double> expiration; // latchtime in seconds, 0 is no deadline
+        std::atomic<bool>   cancelled;
+};
+
+#endif  /* __atl24_deadline__ */
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "OsApi.h"
+#include "TimeLib.h"
+#include "LuaEngine.h"
+#include "Atl24Model.h"
+
+/******************************************************************************
+ * DATA
+ ******************************************************************************/
+
+const char* Atl24Model::DEFAULT_MODEL_NAME = "atl24.tgz";
+
+Mutex Atl24Model::modelsMut;
+string Atl24Model::installed;
+string Atl24Model::directory;
+std::map<string, Atl24Model::entry_t> Atl24Model::current;
+std::map<string, Atl24Model*> Atl24Model::models;
+long Atl24Model::loads = 0;
+double Atl24Model::loadTime = 0.0;
+long Atl24Model::hits = 0;
+
+/******************************************************************************
+ * METHODS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * init - loads the installed model
+ *----------------------------------------------------------------------------*/
+void Atl24Model::init (void)
+{
+    char dir_template[] = "/tmp/atl24model.XXXXXX";
+    if(mkdtemp(dir_template)) directory = dir_template;
+    else print2term("Failed to create model directory: %s\n", strerror(errno));
+
+    installed = FString("%s/%s", CONFDIR, DEFAULT_MODEL_NAME).c_str();
+    const Atl24Model* model = get();
+    if(model) print2term("Classifier model %s [%016lX]\n", installed.c_str(), model->getChecksum());
+    else print2term("Failed to load classifier model %s\n", installed.c_str());
+}
+
+/*----------------------------------------------------------------------------
+ * deinit
+ *----------------------------------------------------------------------------*/
+void Atl24Model::deinit (void)
+{
+    for(auto& entry: models) delete entry.second;
+    models.clear();
+    current.clear();
+    if(!directory.empty()) rmdir(directory.c_str());
+}
+
+/*----------------------------------------------------------------------------
+ * get - returns installed model, NULL if there is none
+ *----------------------------------------------------------------------------*/
+const Atl24Model* Atl24Model::get (void)
+{
+    return get(installed.c_str());
+}
+
+/*----------------------------------------------------------------------------
+ * get - returns model loaded from the current contents of path, NULL if none
+ *
+ *  the ATL24 classify entry points take the path of the model archive, so
+ *  the archive is loaded once into memory and handed to them through a link
+ *  to the in memory copy; the file is only stat'ed on later calls and read
+ *  again when it changes on disk, and a model is identified by its path and
+ *  the checksum of its contents so a beam classifies with exactly the bytes
+ *  its results are cached under; models are kept until deinit (one per
+ *  distinct content of each path) since beams in flight hold them
+ *----------------------------------------------------------------------------*/
+const Atl24Model* Atl24Model::get (const char* path)
+{
+    version_t version;
+    if(!stat(path, version)) return NULL;
+
+    Atl24Model* model = NULL;
+    modelsMut.lock();
+    {
+        auto iter = current.find(path);
+        if(iter != current.end() && iter->second.version.size == version.size && iter->second.version.mtime == version.mtime)
+        {
+            model = iter->second.model;
+            hits++;
+        }
+        else
+        {
+            try
+            {
+                model = load(path);
+                current[path] = {version, model};
+            }
+            catch(const RunTimeException& e)
+            {
+                mlog(e.level(), "Failed to load classifier model %s: %s", path, e.what());
+            }
+        }
+    }
+    modelsMut.unlock();
+
+    return model;
+}
+
+/*----------------------------------------------------------------------------
+ * luaStats - modelstats() --> {loads, load_time, hits, models}
+ *----------------------------------------------------------------------------*/
+int Atl24Model::luaStats (lua_State* L)
+{
+    modelsMut.lock();
+    {
+        lua_newtable(L);
+        LuaEngine::setAttrInt(L, "loads", loads);
+        LuaEngine::setAttrNum(L, "load_time", loadTime);
+        LuaEngine::setAttrInt(L, "hits", hits);
+        LuaEngine::setAttrInt(L, "models", models.size());
+    }
+    modelsMut.unlock();
+    return 1;
+}
+
+/*----------------------------------------------------------------------------
+ * getFilename - path of the in memory copy of the model archive
+ *----------------------------------------------------------------------------*/
+const char* Atl24Model::getFilename (void) const
+{
+    return filename.c_str();
+}
+
+/*----------------------------------------------------------------------------
+ * getChecksum
+ *----------------------------------------------------------------------------*/
+uint64_t Atl24Model::getChecksum (void) const
+{
+    return sum;
+}
+
+/*----------------------------------------------------------------------------
+ * Constructor
+ *
+ *  the archive is copied into an anonymous in memory file, and a link named
+ *  after the checksum and the archive's own file name (so its extension is
+ *  kept) points the classifier at it; index keeps links of models with the
+ *  same contents at different paths apart
+ *----------------------------------------------------------------------------*/
+Atl24Model::Atl24Model (const char* _path, const vector<uint8_t>& contents, uint64_t _sum, long index):
+    sum(_sum),
+    fd(-1)
+{
+    if(directory.empty()) throw RunTimeException(CRITICAL, RTE_FAILURE, "no model directory");
+
+    fd = memfd_create(DEFAULT_MODEL_NAME, MFD_CLOEXEC);
+    if(fd < 0) throw RunTimeException(CRITICAL, RTE_FAILURE, "unable to create in memory file: %s", strerror(errno));
+
+    size_t bytes_written = 0;
+    while(bytes_written < contents.size())
+    {
+        const ssize_t ret = write(fd, &contents[bytes_written], contents.size() - bytes_written);
+        if(ret <= 0)
+        {
+            close(fd);
+            throw RunTimeException(CRITICAL, RTE_FAILURE, "unable to write in memory file: %s", strerror(errno));
+        }
+        bytes_written += ret;
+    }
+
+    const char* basename = strrchr(_path, '/');
+    filename = FString("%s/%ld.%016lX.%s", directory.c_str(), index, sum, basename ? basename + 1 : _path).c_str();
+    const FString target("/proc/%d/fd/%d", getpid(), fd);
+    if(symlink(target.c_str(), filename.c_str()) != 0)
+    {
+        close(fd);
+        throw RunTimeException(CRITICAL, RTE_FAILURE, "unable to link %s: %s", filename.c_str(), strerror(errno));
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * Destructor
+ *----------------------------------------------------------------------------*/
+Atl24Model::~Atl24Model (void)
+{
+    unlink(filename.c_str());
+    close(fd);
+}
+
+/*----------------------------------------------------------------------------
+ * load - must be called with models locked
+ *----------------------------------------------------------------------------*/
+Atl24Model* Atl24Model::load (const char* path)
+{
+    const double start = TimeLib::latchtime();
+
+    /* read archive */
+    vector<uint8_t> contents;
+    fileptr_t file = fopen(path, "rb");
+    if(!file) throw RunTimeException(CRITICAL, RTE_FAILURE, "unable to open: %s", strerror(errno));
+    uint8_t buffer[0x10000];
+    size_t bytes_read;
+    while((bytes_read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        contents.insert(contents.end(), buffer, buffer + bytes_read);
+    }
+    fclose(file);
+
+    /* reuse model of identical contents */
+    const uint64_t contents_sum = checksum(contents.data(), contents.size());
+    const string key = FString("%s:%016lX", path, contents_sum).c_str();
+    auto iter = models.find(key);
+    Atl24Model* model = (iter != models.end()) ? iter->second : NULL;
+    if(!model)
+    {
+        model = new Atl24Model(path, contents, contents_sum, models.size());
+        models[key] = model;
+    }
+
+    loads++;
+    loadTime += TimeLib::latchtime() - start;
+    return model;
+}
+
+/*----------------------------------------------------------------------------
+ * stat - size and modification time of file
+ *----------------------------------------------------------------------------*/
+bool Atl24Model::stat (const char* path, version_t& version)
+{
+    struct stat st;
+    if(::stat(path, &st) != 0) return false;
+    version.size = static_cast<int64_t>(st.st_size);
+    version.mtime = (static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000L) + st.st_mtim.tv_nsec;
+    return true;
+}
+
+/*----------------------------------------------------------------------------
+ * checksum - 64-bit FNV-1a over buffer
+ *----------------------------------------------------------------------------*/
+uint64_t Atl24Model::checksum (const uint8_t* buffer, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for(size_t i = 0; i < size; i++)
+    {
+        hash ^= buffer[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __atl24_model__
+#define __atl24_model__
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <map>
+
+#include "OsApi.h"
+#include "LuaEngine.h"
+
+/******************************************************************************
+ * CLASS
+ ******************************************************************************/
+
+class Atl24Model
+{
+    public:
+
+        /*--------------------------------------------------------------------
+         * Constants
+         *--------------------------------------------------------------------*/
+
+        static const char* DEFAULT_MODEL_NAME;
+
+        /*--------------------------------------------------------------------
+         * Methods
+         *--------------------------------------------------------------------*/
+
+        static void                 init        (void);
+        static void                 deinit      (void);
+        static const Atl24Model*    get         (void);
+        static const Atl24Model*    get         (const char* path);
+        static int                  luaStats    (lua_State* L);
+
+        const char*                 getFilename (void) const;
+        uint64_t                    getChecksum (void) const;
+
+    private:
+
+        /*--------------------------------------------------------------------
+         * Typedefs
+         *--------------------------------------------------------------------*/
+
+        typedef struct {
+            int64_t     size;
+            int64_t     mtime;  // nanoseconds
+        } version_t;
+
+        typedef struct {
+            version_t   version;
+            Atl24Model* model;
+        } entry_t;
+
+        /*--------------------------------------------------------------------
+         * Methods
+         *--------------------------------------------------------------------*/
+
+        Atl24Model  (const char* _path, const vector<uint8_t>& contents, uint64_t _sum, long index);
+        ~Atl24Model (void);
+
+        static Atl24Model*          load        (const char* path);
+        static bool                 stat        (const char* path, version_t& version);
+        static uint64_t             checksum    (const uint8_t* buffer, size_t size);
+
+        /*--------------------------------------------------------------------
+         * Data
+         *--------------------------------------------------------------------*/
+
+        static Mutex                                modelsMut;
+        static string                               installed;  // path of installed model
+        static string                               directory;  // links to in memory copies
+        static std::map<string, entry_t>            current;    // path --> model of its current contents
+        static std::map<string, Atl24Model*>        models;     // path and checksum --> model
+        static long                                 loads;
+        static double                               loadTime;   // seconds
+        static long                                 hits;
+
+        uint64_t                    sum;
+        int                         fd;         // in memory copy of the archive
+        string                      filename;   // path of in memory copy
+};
+
+#endif  /* __atl24_model__ */
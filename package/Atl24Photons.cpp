@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include "photon.h" // ATL24
+
+#include "OsApi.h"
+#include "TimeLib.h"
+#include "BathyDataFrame.h"
+#include "Atl24DataFrame.h"
+#include "Atl24Photons.h"
+
+using ATL24::photon::Photon;
+
+/******************************************************************************
+ * METHODS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * fromBathy - copies rows [start, stop) of dataframe into algorithm input
+ *
+ *  the ATL24 algorithms take and write into a vector of photon structures,
+ *  so the columns cannot be handed to them as views and are copied; p is
+ *  reset to default photons sized to the requested rows (it is reused
+ *  across chunks and beams); only the members used by the classifier,
+ *  surface, kd and roughness algorithms are then populated
+ *----------------------------------------------------------------------------*/
+void Atl24Photons::fromBathy (BathyDataFrame& df, vector<Photon>& p, size_t start, size_t stop)
+{
+    const size_t num_rows = stop - start;
+    p.assign(num_rows, Photon{});
+
+    const int spot = df.spot.value;
+    for(size_t i = 0, j = start; i < num_rows; i++, j++)
+    {
+        p[i].gps_seconds    = TimeLib::sysex2gpstime(df.time_ns[j]);
+        p[i].lat_ph         = df.lat_ph[j];
+        p[i].lon_ph         = df.lon_ph[j];
+        p[i].x_atc          = df.x_atc[j];
+        p[i].h_ph           = df.ellipse_h[j];
+        p[i].geoid          = df.ellipse_h[j] - df.geoid_corr_h[j];
+        p[i].quality_ph     = df.quality_ph[j];
+        p[i].spot           = spot;
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * fromBathy - entire dataframe into algorithm input structure
+ *----------------------------------------------------------------------------*/
+void Atl24Photons::fromBathy (BathyDataFrame& df, vector<Photon>& p)
+{
+    fromBathy(df, p, 0, static_cast<size_t>(df.length()));
+}
+
+/*----------------------------------------------------------------------------
+ * fromAtl24 - dataframe into input structure of ATL24 cleanup algorithm
+ *----------------------------------------------------------------------------*/
+void Atl24Photons::fromAtl24 (Atl24DataFrame& df, vector<Photon>& p)
+{
+    const size_t num_rows = static_cast<size_t>(df.length());
+    p.assign(num_rows, Photon{}); // reused buffer, nothing may carry over from its last use
+
+    // only the below members of the structure are used
+    for(size_t i = 0; i < num_rows; i++)
+    {
+        p[i].x_atc      = df.x_atc[i];
+        p[i].h_ph       = df.ortho_h[i];
+        p[i].class_ph   = df.class_ph[i];
+    }
+}
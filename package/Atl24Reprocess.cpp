@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <hdf5.h>
+
+#include "OsApi.h"
+#include "TimeLib.h"
+#include "FieldColumn.h"
+#include "H5Array.h"
+#include "Atl24Columns.h"
+#include "Atl24Uncertainty.h"
+#include "Atl24Writer.h"
+#include "Atl24Reprocess.h"
+
+/******************************************************************************
+ * STATIC DATA
+ ******************************************************************************/
+
+const char* Atl24Reprocess::OBJECT_TYPE = "Atl24Reprocess";
+const char* Atl24Reprocess::LUA_META_NAME = "Atl24Reprocess";
+const struct luaL_Reg Atl24Reprocess::LUA_META_TABLE[] = {
+    {"update",      luaUpdate},
+    {NULL,          NULL}
+};
+
+/******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * read_dataset - entire one dimensional dataset converted to mem_type
+ *----------------------------------------------------------------------------*/
+template<class T>
+static bool read_dataset (hid_t file, const char* name, hid_t mem_type, vector<T>& values)
+{
+    bool status = false;
+    const hid_t dataset = H5Dopen2(file, name, H5P_DEFAULT);
+    if(dataset < 0) return false;
+
+    const hid_t space = H5Dget_space(dataset);
+    if(space >= 0)
+    {
+        hsize_t dims[1] = {0};
+        if(H5Sget_simple_extent_ndims(space) == 1 && H5Sget_simple_extent_dims(space, dims, NULL) == 1)
+        {
+            values.resize(dims[0]);
+            status = dims[0] == 0 || H5Dread(dataset, mem_type, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data()) >= 0;
+        }
+        H5Sclose(space);
+    }
+
+    H5Dclose(dataset);
+    return status;
+}
+
+/*----------------------------------------------------------------------------
+ * write_dataset - overwrites the values of an existing float dataset in place
+ *----------------------------------------------------------------------------*/
+static bool write_dataset (hid_t file, const char* name, const vector<float>& values)
+{
+    bool status = false;
+    const hid_t dataset = H5Dopen2(file, name, H5P_DEFAULT);
+    if(dataset < 0) return false;
+
+    const hid_t space = H5Dget_space(dataset);
+    if(space >= 0)
+    {
+        const hssize_t num_elements = H5Sget_simple_extent_npoints(space);
+        if(num_elements == static_cast<hssize_t>(values.size()))
+        {
+            status = num_elements == 0 || H5Dwrite(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, values.data()) >= 0;
+        }
+        H5Sclose(space);
+    }
+
+    H5Dclose(dataset);
+    return status;
+}
+
+/*----------------------------------------------------------------------------
+ * to_column - values appended to an empty column
+ *----------------------------------------------------------------------------*/
+static void to_column (const vector<float>& values, FieldColumn<float>& column)
+{
+    Atl24Columns::append(&column, values.data(), static_cast<long>(values.size()));
+}
+
+/******************************************************************************
+ * METHODS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * luaCreate - reprocess(<atl03 h5 object>, [<fast path>], [<read timeout>])
+ *
+ *  reruns the uncertainty calculation on an existing ATL24 granule; the
+ *  ATL03 granule the ATL24 granule was generated from supplies the
+ *  geolocation terms that are not carried in ATL24
+ *----------------------------------------------------------------------------*/
+int Atl24Reprocess::luaCreate (lua_State* L)
+{
+    H5Object* _atl03h5 = NULL;
+
+    try
+    {
+        _atl03h5 = dynamic_cast<H5Object*>(getLuaObject(L, 1, H5Object::OBJECT_TYPE));
+        const bool _fast_path = getLuaBoolean(L, 2, true, Atl24Uncertainty::DEFAULT_FAST_PATH);
+        const int _read_timeout = getLuaInteger(L, 3, true, DEFAULT_READ_TIMEOUT);
+        return createLuaObject(L, new Atl24Reprocess(L, _atl03h5, _fast_path, _read_timeout));
+    }
+    catch(const RunTimeException& e)
+    {
+        if(_atl03h5) _atl03h5->releaseLuaObject();
+        mlog(e.level(), "Error creating %s: %s", LUA_META_NAME, e.what());
+        return returnLuaStatus(L, false);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * Constructor
+ *----------------------------------------------------------------------------*/
+Atl24Reprocess::Atl24Reprocess(lua_State* L, H5Object* _atl03h5, bool _fast_path, int _read_timeout):
+    LuaObject(L, OBJECT_TYPE, LUA_META_NAME, LUA_META_TABLE),
+    atl03h5(_atl03h5),
+    fastPath(_fast_path),
+    readTimeout(_read_timeout)
+{
+}
+
+/*----------------------------------------------------------------------------
+ * Destructor
+ *----------------------------------------------------------------------------*/
+Atl24Reprocess::~Atl24Reprocess(void)
+{
+    if(atl03h5) atl03h5->releaseLuaObject();
+}
+
+/*----------------------------------------------------------------------------
+ * luaUpdate - :update(<filename>) --> status, number of beams updated
+ *
+ *  rewrites only the sigma_thu and sigma_tvu datasets of each beam in the
+ *  local ATL24 file; every other dataset is left untouched
+ *----------------------------------------------------------------------------*/
+int Atl24Reprocess::luaUpdate (lua_State* L)
+{
+    bool status = true;
+    long num_updated = 0;
+
+    try
+    {
+        /* Get Self */
+        Atl24Reprocess* lua_obj = dynamic_cast<Atl24Reprocess*>(getLuaSelf(L, 1));
+
+        /* Get Filename */
+        const char* filename = getLuaString(L, 2);
+
+        /* Open File */
+        const double start = TimeLib::latchtime();
+        const hid_t file = H5Fopen(filename, H5F_ACC_RDWR, H5P_DEFAULT);
+        if(file < 0) throw RunTimeException(CRITICAL, RTE_FAILURE, "unable to open %s for update", filename);
+
+        /* Update Each Beam in File */
+        for(int i = 0; i < Atl24Writer::NUM_BEAMS; i++)
+        {
+            const char* beam = Atl24Writer::BEAMS[i];
+            if(H5Lexists(file, beam, H5P_DEFAULT) <= 0) continue; // beam not in granule
+            if(lua_obj->updateBeam(file, beam)) num_updated++;
+            else status = false;
+        }
+
+        /* Close File */
+        if(H5Fclose(file) < 0)
+        {
+            mlog(CRITICAL, "Failed to close %s", filename);
+            status = false;
+        }
+
+        mlog(INFO, "Updated uncertainty of %ld beams in %s in %.3lf seconds", num_updated, filename, TimeLib::latchtime() - start);
+    }
+    catch(const RunTimeException& e)
+    {
+        mlog(e.level(), "Error updating uncertainty: %s", e.what());
+        status = false;
+    }
+
+    lua_pushboolean(L, status);
+    lua_pushinteger(L, num_updated);
+    return 2;
+}
+
+/*----------------------------------------------------------------------------
+ * updateBeam
+ *----------------------------------------------------------------------------*/
+bool Atl24Reprocess::updateBeam (hid_t file, const char* beam)
+{
+    /* Read ATL24 Inputs */
+    vector<float> surface_h;
+    vector<float> kd;
+    vector<float> surface_roughness;
+    vector<float> ortho_h;
+    vector<int64_t> index_seg;
+    vector<int32_t> segment_id;
+    if(!read_dataset(file, FString("%s/surface_h", beam).c_str(), H5T_NATIVE_FLOAT, surface_h) ||
+       !read_dataset(file, FString("%s/kd", beam).c_str(), H5T_NATIVE_FLOAT, kd) ||
+       !read_dataset(file, FString("%s/surface_roughness", beam).c_str(), H5T_NATIVE_FLOAT, surface_roughness) ||
+       !read_dataset(file, FString("%s/ortho_h", beam).c_str(), H5T_NATIVE_FLOAT, ortho_h) ||
+       !read_dataset(file, FString("%s/index_seg", beam).c_str(), H5T_NATIVE_INT64, index_seg) ||
+       !read_dataset(file, FString("%s/segment_id", beam).c_str(), H5T_NATIVE_INT32, segment_id))
+    {
+        mlog(CRITICAL, "Failed to read uncertainty inputs of %s", beam);
+        return false;
+    }
+
+    /* Check ATL24 Inputs */
+    const size_t num_rows = surface_h.size();
+    if(kd.size() != num_rows || surface_roughness.size() != num_rows || ortho_h.size() != num_rows || index_seg.size() != num_rows || segment_id.size() != num_rows)
+    {
+        mlog(CRITICAL, "Uncertainty inputs of %s have different lengths", beam);
+        return false;
+    }
+
+    try
+    {
+        /* Read ATL03 Geolocation (per segment) */
+        H5Array<float> ref_elev(atl03h5, FString("%s/geolocation/ref_elev", beam).c_str());
+        H5Array<float> sigma_h(atl03h5, FString("%s/geolocation/sigma_h", beam).c_str());
+        H5Array<float> sigma_along(atl03h5, FString("%s/geolocation/sigma_along", beam).c_str());
+        H5Array<float> sigma_across(atl03h5, FString("%s/geolocation/sigma_across", beam).c_str());
+        H5Array<int32_t> atl03_segment_id(atl03h5, FString("%s/geolocation/segment_id", beam).c_str());
+        ref_elev.join(readTimeout * 1000, true);
+        sigma_h.join(readTimeout * 1000, true);
+        sigma_along.join(readTimeout * 1000, true);
+        sigma_across.join(readTimeout * 1000, true);
+        atl03_segment_id.join(readTimeout * 1000, true);
+
+        /* Expand Geolocation to Photons (checked against segment id so a mismatched ATL03 granule is caught) */
+        const long chunk_size = Atl24Columns::chunkSize(num_rows);
+        FieldColumn<float> ref_el_column(0, chunk_size);
+        FieldColumn<float> sigma_h_column(0, chunk_size);
+        FieldColumn<float> sigma_along_column(0, chunk_size);
+        FieldColumn<float> sigma_across_column(0, chunk_size);
+        for(size_t i = 0; i < num_rows; i++)
+        {
+            const int64_t seg = index_seg[i];
+            if(seg < 0 || seg >= atl03_segment_id.size || atl03_segment_id[seg] != segment_id[i])
+            {
+                throw RunTimeException(CRITICAL, RTE_FAILURE, "photon %ld does not match ATL03 segment %ld", static_cast<long>(i), static_cast<long>(seg));
+            }
+            ref_el_column.append(ref_elev[seg]);
+            sigma_h_column.append(sigma_h[seg]);
+            sigma_along_column.append(sigma_along[seg]);
+            sigma_across_column.append(sigma_across[seg]);
+        }
+
+        /* Calculate Uncertainties */
+        FieldColumn<float> surface_h_column(0, chunk_size);
+        FieldColumn<float> kd_column(0, chunk_size);
+        FieldColumn<float> surface_roughness_column(0, chunk_size);
+        FieldColumn<float> ortho_h_column(0, chunk_size);
+        to_column(surface_h, surface_h_column);
+        to_column(kd, kd_column);
+        to_column(surface_roughness, surface_roughness_column);
+        to_column(ortho_h, ortho_h_column);
+        FieldColumn<float> sigma_thu_column(0, chunk_size);
+        FieldColumn<float> sigma_tvu_column(0, chunk_size);
+        const Atl24Uncertainty::inputs_t in = {&surface_h_column, &kd_column, &surface_roughness_column, &ref_el_column, &ortho_h_column, &sigma_h_column, &sigma_along_column, &sigma_across_column};
+        Atl24Uncertainty::calculate(in, num_rows, fastPath, &sigma_thu_column, &sigma_tvu_column);
+
+        vector<float> sigma_thu(num_rows);
+        vector<float> sigma_tvu(num_rows);
+        for(size_t i = 0; i < num_rows; i++)
+        {
+            sigma_thu[i] = sigma_thu_column[i];
+            sigma_tvu[i] = sigma_tvu_column[i];
+        }
+
+        /* Rewrite Uncertainty Datasets */
+        if(!write_dataset(file, FString("%s/sigma_thu", beam).c_str(), sigma_thu) ||
+           !write_dataset(file, FString("%s/sigma_tvu", beam).c_str(), sigma_tvu))
+        {
+            mlog(CRITICAL, "Failed to write uncertainty of %s", beam);
+            return false;
+        }
+    }
+    catch(const RunTimeException& e)
+    {
+        mlog(e.level(), "Failed to recalculate uncertainty of %s: %s", beam, e.what());
+        return false;
+    }
+
+    mlog(INFO, "Recalculated uncertainty of %ld photons in %s", static_cast<long>(num_rows), beam);
+    return true;
+}
@@ -35,6 +35,9 @@
 
 #include <math.h>
 #include <float.h>
+#include <atomic>
+#include <algorithm>
+#include <omp.h>
 
 #include "atl24.h"
 #include "ensemble.h"
@@ -49,6 +52,13 @@
 #include "FieldElement.h"
 #include "Icesat2Parameters.h"
 #include "BathyDataFrame.h"
+#include "Atl24Model.h"
+#include "Atl24Capture.h"
+#include "Atl24Cache.h"
+#include "Atl24Arena.h"
+#include "Atl24Scheduler.h"
+#include "Atl24Photons.h"
+#include "Atl24Columns.h"
 #include "Atl24Runner.h"
 
 /******************************************************************************
@@ -57,15 +67,155 @@
 
 const char* Atl24Runner::LUA_META_NAME = "Atl24Runner";
 const struct luaL_Reg Atl24Runner::LUA_META_TABLE[] = {
+    {"deadline",    luaDeadline},
+    {"cancel",      luaCancel},
     {NULL,          NULL}
 };
 
+/******************************************************************************
+ * LOCAL TYPES
+ ******************************************************************************/
+
+typedef struct {
+    vector<ATL24::photon::Photon>*          p;
+    int                                     threads;    // openmp threads of stage
+    vector<double>                          estimates;
+    double                                  time;       // seconds
+    string                                  error;
+} stage_task_t;
+
+typedef struct {
+    BathyDataFrame*                         df;
+    const vector<Atl24Runner::chunk_t>*     chunks;
+    const char*                             model_filename;
+    Atl24Runner::results_t*                 results;
+    const Atl24Deadline*                    deadline;
+    std::atomic<size_t>                     next_chunk;
+    long                                    predictor_threads; // per chunk thread
+    Mutex                                   error_mut;  // also protects times
+    string                                  error;
+    Atl24Runner::stage_times_t              times;
+} chunk_work_t;
+
+/******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * kd_stage - estimates kd from classified photons
+ *----------------------------------------------------------------------------*/
+static void* kd_stage (void* parm)
+{
+    stage_task_t* task = static_cast<stage_task_t*>(parm);
+    omp_set_num_threads(task->threads); // new threads start with the process default
+    try
+    {
+        const ATL24::estimate_kd::Params estimate_kd_params;
+        const double start = TimeLib::latchtime();
+        task->estimates = ATL24::estimate_kd::classify (*task->p, estimate_kd_params);
+        task->time = TimeLib::latchtime() - start;
+        if(task->estimates.size() != task->p->size()) throw RunTimeException(CRITICAL, RTE_FAILURE, "size mismatch in returned kd estimates: %lu != %lu", task->estimates.size(), task->p->size());
+    }
+    catch(const std::exception& e)
+    {
+        task->error = e.what();
+    }
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------
+ * roughness_stage - estimates surface roughness from classified photons
+ *----------------------------------------------------------------------------*/
+static void* roughness_stage (void* parm)
+{
+    stage_task_t* task = static_cast<stage_task_t*>(parm);
+    omp_set_num_threads(task->threads); // new threads start with the process default
+    try
+    {
+        const ATL24::estimate_surface_roughness::Params estimate_surface_roughness_params;
+        const double start = TimeLib::latchtime();
+        task->estimates = ATL24::estimate_surface_roughness::classify (*task->p, estimate_surface_roughness_params);
+        task->time = TimeLib::latchtime() - start;
+        if(task->estimates.size() != task->p->size()) throw RunTimeException(CRITICAL, RTE_FAILURE, "size mismatch in returned estimated surface roughness: %lu != %lu", task->estimates.size(), task->p->size());
+    }
+    catch(const std::exception& e)
+    {
+        task->error = e.what();
+    }
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------
+ * chunk_thread - pulls chunks off of the shared work list until exhausted
+ *----------------------------------------------------------------------------*/
+static void* chunk_thread (void* parm)
+{
+    chunk_work_t* work = static_cast<chunk_work_t*>(parm);
+    Atl24Runner::stage_times_t times = {0.0, 0.0, 0.0, 0.0, 0.0};
+    omp_set_num_threads(work->predictor_threads); // new threads start with the process default
+    const Atl24Runner::chunk_t& first = (*work->chunks)[0];
+    Atl24Arena* arena = Atl24Arena::acquire(first.window_stop - first.window_start);
+    vector<ATL24::photon::Photon>& window = arena->photons;
+
+    size_t c;
+    while((c = work->next_chunk++) < work->chunks->size())
+    {
+        const Atl24Runner::chunk_t& chunk = (*work->chunks)[c];
+        try
+        {
+            work->deadline->check("along-track chunk");
+            const double start = TimeLib::latchtime();
+            Atl24Photons::fromBathy(*work->df, window, chunk.window_start, chunk.window_stop);
+            times.photons += TimeLib::latchtime() - start;
+            Atl24Runner::classifyPhotons(window, work->model_filename, *work->results, chunk.core_start - chunk.window_start, chunk.core_stop - chunk.window_start, chunk.core_start, times, false, NULL, work->deadline);
+        }
+        catch(const std::exception& e)
+        {
+            work->error_mut.lock();
+            {
+                if(work->error.empty()) work->error = e.what();
+            }
+            work->error_mut.unlock();
+            work->next_chunk = work->chunks->size(); // stop remaining work
+        }
+    }
+
+    Atl24Arena::release(arena);
+
+    // accumulate stage times of this thread
+    work->error_mut.lock();
+    {
+        work->times.photons += times.photons;
+        work->times.classify += times.classify;
+        work->times.elevations += times.elevations;
+        work->times.kd += times.kd;
+        work->times.roughness += times.roughness;
+    }
+    work->error_mut.unlock();
+
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------
+ * populate - appends results to column and empties them
+ *----------------------------------------------------------------------------*/
+template<class T>
+static void populate (FieldColumn<T>* column, vector<T>& values)
+{
+    Atl24Columns::append(column, values.data(), static_cast<long>(values.size()));
+    values.clear(); // capacity stays with the arena
+}
+
 /******************************************************************************
  * METHODS
  ******************************************************************************/
 
  /*----------------------------------------------------------------------------
- * luaCreate - create(<parms>)
+ * luaCreate - create(<parms>, [{chunk_size=<photons>, chunk_halo=<meters>, batch_beams=<beams>}])
+ *
+ *  the second argument used to be the serialize threshold, which the beam
+ *  scheduler replaced; a number there is rejected rather than read as
+ *  something else
  *----------------------------------------------------------------------------*/
 int Atl24Runner::luaCreate (lua_State* L)
 {
@@ -74,8 +224,34 @@ int Atl24Runner::luaCreate (lua_State* L)
     try
     {
         _parms = dynamic_cast<Icesat2Parameters*>(getLuaObject(L, 1, Icesat2Parameters::OBJECT_TYPE));
-        const long _serialize_threshold = getLuaInteger(L, 2, true, DEFAULT_SERIALIZE_THRESHOLD);
-        return createLuaObject(L, new Atl24Runner(L, _parms, _serialize_threshold));
+
+        long _chunk_size = DEFAULT_CHUNK_SIZE;
+        double _chunk_halo = DEFAULT_CHUNK_HALO;
+        long _batch_beams = DEFAULT_BATCH_BEAMS;
+        if(lua_istable(L, 2))
+        {
+            lua_getfield(L, 2, "chunk_size");
+            _chunk_size = getLuaInteger(L, -1, true, DEFAULT_CHUNK_SIZE);
+            lua_pop(L, 1);
+
+            lua_getfield(L, 2, "chunk_halo");
+            _chunk_halo = getLuaFloat(L, -1, true, DEFAULT_CHUNK_HALO);
+            lua_pop(L, 1);
+
+            lua_getfield(L, 2, "batch_beams");
+            _batch_beams = getLuaInteger(L, -1, true, DEFAULT_BATCH_BEAMS);
+            lua_pop(L, 1);
+        }
+        else if(!lua_isnoneornil(L, 2))
+        {
+            throw RunTimeException(CRITICAL, RTE_FAILURE, "options must be a table (the serialize threshold argument was removed, see atl24.scheduler)");
+        }
+
+        if(_chunk_size < 0) throw RunTimeException(CRITICAL, RTE_FAILURE, "invalid chunk size: %ld", _chunk_size);
+        if(_chunk_halo < 0.0) throw RunTimeException(CRITICAL, RTE_FAILURE, "invalid chunk halo: %lf", _chunk_halo);
+        if(_batch_beams < 0) throw RunTimeException(CRITICAL, RTE_FAILURE, "invalid batch beams: %ld", _batch_beams);
+
+        return createLuaObject(L, new Atl24Runner(L, _parms, _chunk_size, _chunk_halo, _batch_beams));
     }
     catch(const RunTimeException& e)
     {
@@ -88,10 +264,12 @@ int Atl24Runner::luaCreate (lua_State* L)
 /*----------------------------------------------------------------------------
  * Constructor
  *----------------------------------------------------------------------------*/
-Atl24Runner::Atl24Runner (lua_State* L, Icesat2Parameters* _parms, long _serialize_threshold):
+Atl24Runner::Atl24Runner (lua_State* L, Icesat2Parameters* _parms, long _chunk_size, double _chunk_halo, long _batch_beams):
     GeoDataFrame::FrameRunner(L, LUA_META_NAME, LUA_META_TABLE),
     parms(_parms),
-    serializeThreshold(_serialize_threshold)
+    chunkSize(_chunk_size),
+    chunkHalo(_chunk_halo),
+    batchBeams(_batch_beams)
 {
 }
 
@@ -103,96 +281,477 @@ Atl24Runner::~Atl24Runner (void)
     if(parms) parms->releaseLuaObject();
 }
 
+/*----------------------------------------------------------------------------
+ * classifyPhotons - runs algorithm stages on p, keeping results for core rows
+ *
+ *  results for p[core_start..core_stop) are written to results starting at
+ *  row dest; the remaining photons only provide context to the algorithms.
+ *  The sea surface, kd and surface roughness stages only read the classified
+ *  photons, so when concurrent is set kd and roughness run in their own
+ *  threads alongside the sea surface stage.  When classified is supplied the
+ *  photons have already been labeled (in a batch with other beams) and the
+ *  classifier is not run again.  When a deadline
+ *  is supplied it is checked before each stage, and an exception is thrown
+ *  once it has passed so the remaining stages are not run.
+ *----------------------------------------------------------------------------*/
+void Atl24Runner::classifyPhotons (vector<ATL24::photon::Photon>& p, const char* model_filename, results_t& results, size_t core_start, size_t core_stop, size_t dest, stage_times_t& times, bool concurrent, const classification_t* classified, const Atl24Deadline* deadline)
+{
+    const ATL24::elevations::ElevationsParams elevations_params;
+    const size_t num_rows = p.size();
+    double start = TimeLib::latchtime();
+
+    // classify photons
+    if(deadline) deadline->check("classification");
+    classification_t single;
+    if(!classified) single = classifySingle(p, model_filename);
+    const classification_t& classification = classified ? *classified : single;
+    if(classification.labels.size() != num_rows) throw RunTimeException(CRITICAL, RTE_FAILURE, "size mismatch in returned labels: %lu != %lu", classification.labels.size(), num_rows);
+    for(size_t i = 0; i < classification.labels.size(); i++) // class_ph and labels needs to be populated for kd and surface roughness algorithms
+    {
+        p[i].class_ph = classification.labels[i];
+        p[i].label    = static_cast<ATL24::photon::Label>(classification.labels[i]);
+    }
+    times.classify += TimeLib::latchtime() - start;
+    if(deadline) deadline->check("sea surface elevations");
+    start = TimeLib::latchtime();
+
+    // start kd and surface roughness estimation
+    //  (the caller's threads are split across the three concurrent stages)
+    const int threads = omp_get_max_threads();
+    const int stage_threads = concurrent ? MAX(threads / 3, 1) : threads;
+    stage_task_t kd_task = {&p, stage_threads, {}, 0.0, ""};
+    stage_task_t roughness_task = {&p, stage_threads, {}, 0.0, ""};
+    Thread* kd_thread = NULL;
+    Thread* roughness_thread = NULL;
+    if(concurrent)
+    {
+        omp_set_num_threads(stage_threads);
+        kd_thread = new Thread(kd_stage, &kd_task);
+        roughness_thread = new Thread(roughness_stage, &roughness_task);
+    }
+
+    // generate sea surface elevation
+    vector<ATL24::elevations::Elevations> elevations;
+    string elevations_error;
+    try
+    {
+        elevations = ATL24::elevations::get_elevations (p, elevations_params);
+        if(elevations.size() != num_rows) throw RunTimeException(CRITICAL, RTE_FAILURE, "size mismatch in returned elevations: %lu != %lu", elevations.size(), num_rows);
+    }
+    catch(const std::exception& e)
+    {
+        elevations_error = e.what();
+    }
+    times.elevations += TimeLib::latchtime() - start;
+
+    // estimate kd and surface roughness
+    if(concurrent)
+    {
+        delete kd_thread; // joins
+        delete roughness_thread; // joins
+        omp_set_num_threads(threads);
+    }
+    else if(elevations_error.empty())
+    {
+        if(deadline) deadline->check("kd estimation");
+        kd_stage(&kd_task);
+        if(deadline) deadline->check("surface roughness estimation");
+        if(kd_task.error.empty()) roughness_stage(&roughness_task);
+    }
+    times.kd += kd_task.time;
+    times.roughness += roughness_task.time;
+
+    // check stages
+    if(!elevations_error.empty()) throw RunTimeException(CRITICAL, RTE_FAILURE, "%s", elevations_error.c_str());
+    if(!kd_task.error.empty()) throw RunTimeException(CRITICAL, RTE_FAILURE, "%s", kd_task.error.c_str());
+    if(!roughness_task.error.empty()) throw RunTimeException(CRITICAL, RTE_FAILURE, "%s", roughness_task.error.c_str());
+    const vector<double>& kd_estimates = kd_task.estimates;
+    const vector<double>& estimated_surface_roughness = roughness_task.estimates;
+
+    // keep results of core photons
+    for(size_t i = core_start, j = dest; i < core_stop; i++, j++)
+    {
+        results.class_ph[j] = classification.labels[i];
+        results.confidence[j] = classification.bathy_prob[i];
+        results.surface_h[j] = static_cast<float>(elevations[i].sea_surface_elevation);
+        results.kd[j] = static_cast<float>(kd_estimates[i]);
+        results.surface_roughness[j] = static_cast<float>(estimated_surface_roughness[i]);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * compact - keeps labels and bathymetry probability of n photons at offset
+ *
+ *  the classifier returns a vector of per-class probabilities for every
+ *  photon; only the bathymetry column is used, so it is copied out into a
+ *  contiguous array and the per-photon vectors are freed as they are read
+ *----------------------------------------------------------------------------*/
+void Atl24Runner::compact (ATL24::xgboost::ClassificationResult& result, size_t offset, size_t n, classification_t& classification)
+{
+    static const size_t bathy_index = ATL24::labeling::label_map.at(static_cast<int>(ATL24::photon::Label::bathy));
+
+    classification.labels.assign(result.labels.begin() + offset, result.labels.begin() + offset + n);
+    classification.bathy_prob.resize(n);
+    for(size_t i = 0; i < n; i++)
+    {
+        auto& probabilities = result.probabilities[offset + i];
+        classification.bathy_prob[i] = static_cast<float>(probabilities[bathy_index]);
+        probabilities.clear();
+        probabilities.shrink_to_fit();
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * classifySingle - classifies p on its own
+ *----------------------------------------------------------------------------*/
+Atl24Runner::classification_t Atl24Runner::classifySingle (vector<ATL24::photon::Photon>& p, const char* model_filename)
+{
+    const ATL24::ensemble::Params ensemble_params;
+    classification_t classification;
+    {
+        ATL24::xgboost::ClassificationResult result = ATL24::main_pipeline::classify (p, model_filename, true, ensemble_params);
+        if(result.labels.size() != p.size() || result.probabilities.size() != p.size()) throw RunTimeException(CRITICAL, RTE_FAILURE, "size mismatch in returned classification: %lu,%lu != %lu", result.labels.size(), result.probabilities.size(), p.size());
+        compact(result, 0, p.size(), classification);
+    } // releases full classifier result
+    return classification;
+}
+
+/*----------------------------------------------------------------------------
+ * classifyBatch - one classifier call over the photons of several beams
+ *
+ *  beams are concatenated with their along-track distances shifted apart by
+ *  BATCH_GAP so that no photon shares a neighborhood with another beam
+ *----------------------------------------------------------------------------*/
+void Atl24Runner::classifyBatch (const vector<vector<ATL24::photon::Photon>*>& beams, const char* model_filename, vector<classification_t>& classifications)
+{
+    const ATL24::ensemble::Params ensemble_params;
+
+    // concatenate beams
+    vector<ATL24::photon::Photon> all;
+    size_t total = 0;
+    for(const vector<ATL24::photon::Photon>* p: beams) total += p->size();
+    all.reserve(total);
+    double next_x = 0.0;
+    for(const vector<ATL24::photon::Photon>* p: beams)
+    {
+        if(p->empty()) continue;
+        double min_x = (*p)[0].x_atc;
+        double max_x = (*p)[0].x_atc;
+        for(const ATL24::photon::Photon& ph: *p)
+        {
+            min_x = MIN(min_x, ph.x_atc);
+            max_x = MAX(max_x, ph.x_atc);
+        }
+        const double shift = next_x - min_x;
+        for(const ATL24::photon::Photon& ph: *p)
+        {
+            all.push_back(ph);
+            all.back().x_atc += shift;
+        }
+        next_x = max_x + shift + BATCH_GAP;
+    }
+
+    // classify all beams at once
+    mlog(INFO, "Classifying %lu photons from %lu beams in one batch", total, beams.size());
+    ATL24::xgboost::ClassificationResult classification = ATL24::main_pipeline::classify (all, model_filename, true, ensemble_params);
+    if(classification.labels.size() != total || classification.probabilities.size() != total) throw RunTimeException(CRITICAL, RTE_FAILURE, "size mismatch in returned classification: %lu,%lu != %lu", classification.labels.size(), classification.probabilities.size(), total);
+    vector<ATL24::photon::Photon>().swap(all);
+
+    // hand results back to each beam
+    classifications.resize(beams.size());
+    size_t offset = 0;
+    for(size_t b = 0; b < beams.size(); b++)
+    {
+        const size_t n = beams[b]->size();
+        compact(classification, offset, n, classifications[b]);
+        offset += n;
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * classifyBatched - classifies df together with other beams of its granule
+ *
+ *  called before the beam is admitted, so a beam waiting for its batch holds
+ *  no scheduler ticket and no working buffers; the beam that completes a
+ *  batch, or that times out waiting for one, is admitted once for the whole
+ *  batch and runs the classifier for every beam of its granule waiting at
+ *  that point while the others block until their labels are handed back.
+ *  A beam still waiting when the deadline passes leaves the batch.  Returns
+ *  the seconds this beam spent running the classifier for its batch.
+ *----------------------------------------------------------------------------*/
+double Atl24Runner::classifyBatched (BathyDataFrame& df, const char* model_filename, classification_t& classification)
+{
+    const string granule = df.granule.value;
+    batch_entry_t entry = {&df, {}, false, ""};
+    vector<batch_entry_t*> entries;
+    bool cancelled = false;
+    const double start = TimeLib::latchtime();
+
+    deadline.check("batch");
+
+    batchCond.lock();
+    {
+        vector<batch_entry_t*>& pending = batchPending[granule];
+        pending.push_back(&entry);
+        if(static_cast<long>(pending.size()) >= batchBeams)
+        {
+            entries.swap(pending);
+            batchPending.erase(granule);
+        }
+        else
+        {
+            while(!entry.done && entries.empty())
+            {
+                batchCond.wait(0, Atl24Deadline::POLL_MS);
+                if(entry.done) break;
+
+                // nothing to do once another beam has claimed the batch
+                auto iter = batchPending.find(granule);
+                if(iter == batchPending.end()) continue;
+                vector<batch_entry_t*>& waiting = iter->second;
+                auto position = std::find(waiting.begin(), waiting.end(), &entry);
+                if(position == waiting.end()) continue;
+
+                if(deadline.expired())
+                {
+                    // leave the batch, the rest of it still runs without this beam
+                    waiting.erase(position);
+                    if(waiting.empty()) batchPending.erase(iter);
+                    cancelled = true;
+                    break;
+                }
+                else if(TimeLib::latchtime() - start >= BATCH_WAIT_MS / 1000.0)
+                {
+                    // batch did not fill in time, run what has arrived
+                    entries.swap(waiting);
+                    batchPending.erase(iter);
+                }
+            }
+        }
+    }
+    batchCond.unlock();
+
+    if(cancelled) throw RunTimeException(WARNING, RTE_TIMEOUT, "cancelled while waiting for batch");
+
+    // run the batch this beam claimed
+    double classify_time = 0.0;
+    if(!entries.empty())
+    {
+        Atl24Scheduler::ticket_t ticket = {-1, 0, 0, 0.0};
+        try
+        {
+            // admit the batch as one
+            long num_rows = 0;
+            for(batch_entry_t* e: entries) num_rows += e->df->length();
+            ticket = Atl24Scheduler::admit(num_rows, &deadline, entries.size());
+            if(ticket.id < 0) throw RunTimeException(WARNING, RTE_TIMEOUT, "cancelled before admission");
+            omp_set_num_threads(ticket.threads);
+
+            // classify photons of every beam in the batch
+            vector<vector<ATL24::photon::Photon>> photons(entries.size());
+            vector<vector<ATL24::photon::Photon>*> beams;
+            for(size_t b = 0; b < entries.size(); b++)
+            {
+                Atl24Photons::fromBathy(*entries[b]->df, photons[b]);
+                beams.push_back(&photons[b]);
+            }
+            vector<classification_t> classifications;
+            const double classify_start = TimeLib::latchtime();
+            classifyBatch(beams, model_filename, classifications);
+            classify_time = TimeLib::latchtime() - classify_start;
+            for(size_t b = 0; b < entries.size(); b++)
+            {
+                entries[b]->classification = std::move(classifications[b]);
+            }
+        }
+        catch(const std::exception& e)
+        {
+            for(batch_entry_t* member: entries) member->error = e.what();
+        }
+        if(ticket.id >= 0) Atl24Scheduler::release(ticket);
+
+        batchCond.lock();
+        {
+            for(batch_entry_t* e: entries) e->done = true;
+            batchCond.signal(0, Cond::NOTIFY_ALL);
+        }
+        batchCond.unlock();
+    }
+
+    if(!entry.error.empty()) throw RunTimeException(CRITICAL, RTE_FAILURE, "batched classification failed: %s", entry.error.c_str());
+    classification = std::move(entry.classification);
+    return classify_time;
+}
+
 /*----------------------------------------------------------------------------
  * run
  *----------------------------------------------------------------------------*/
 bool Atl24Runner::run (GeoDataFrame* dataframe)
 {
     bool status = true;
-    const ATL24::ensemble::Params ensemble_params;
-    const ATL24::elevations::ElevationsParams elevations_params;
-    const ATL24::estimate_kd::Params estimate_kd_params;
-    const ATL24::estimate_surface_roughness::Params estimate_surface_roughness_params;
-    FString model_filename("%s/atl24.tgz", CONFDIR);
 
     // cast dataframe to ATL24 specific dataframe
     BathyDataFrame& df = *dynamic_cast<BathyDataFrame*>(dataframe);
     size_t num_rows = static_cast<size_t>(df.length());
+    stage_times_t times = {0.0, 0.0, 0.0, 0.0, 0.0};
+    double populate_time = 0.0;
+    double run_time = 0.0;
 
     // create new columns
-    FieldColumn<int>* class_ph = new FieldColumn<int>;
-    FieldColumn<float>* confidence = new FieldColumn<float>;
-    FieldColumn<float>* surface_h = new FieldColumn<float>;
-    FieldColumn<float>* kd = new FieldColumn<float>;
-    FieldColumn<float>* surface_roughness = new FieldColumn<float>;
+    FieldColumn<int>* class_ph = Atl24Columns::create<int>(df.length());
+    FieldColumn<float>* confidence = Atl24Columns::create<float>(df.length());
+    FieldColumn<float>* surface_h = Atl24Columns::create<float>(df.length());
+    FieldColumn<float>* kd = Atl24Columns::create<float>(df.length());
+    FieldColumn<float>* surface_roughness = Atl24Columns::create<float>(df.length());
 
-    // determine serialization
-    const bool serialize = df.length() > serializeThreshold;
-    mlog(INFO, "Running classifier on spot %d in %s mode", df.spot.value, serialize ? "serial" : "parallel");
+    // capture classifier inputs for offline replay
+    if(Atl24Capture::enabled()) Atl24Capture::write(df);
 
-    try
+    // get installed classifier model
+    const Atl24Model* model = Atl24Model::get();
+
+    // reuse results of an identical earlier run of this beam
+    Atl24Arena* arena = Atl24Arena::acquire(num_rows);
+    string cache_key;
+    bool cached = false;
+    if(Atl24Cache::enabled() && model)
+    {
+        const FString mode("chunk_size=%ld chunk_halo=%.3lf batch_beams=%ld", chunkSize, chunkHalo, batchBeams); // chunked and batched results may differ from a single pass
+        cache_key = Atl24Cache::key(df, mode.c_str(), model->getChecksum());
+        cached = Atl24Cache::load(df, cache_key, arena->results);
+    }
+
+    // classify with the other beams of the granule (working buffers are handed back while the batch forms)
+    const bool batched = !cached && model && batchBeams > 1 && !(chunkSize > 0 && num_rows > static_cast<size_t>(chunkSize));
+    classification_t batch_classification;
+    double batch_time = 0.0;
+    string batch_error;
+    if(batched)
     {
-        // convert dataframe to algorithm input structure
-        vector<ATL24::photon::Photon> p(df.length());
-        for(size_t i = 0; i < static_cast<size_t>(df.length()); ++i)
+        Atl24Arena::release(arena);
+        try
         {
-            p[i].gps_seconds    = TimeLib::sysex2gpstime(df.time_ns[i]);
-            p[i].lat_ph         = df.lat_ph[i];
-            p[i].lon_ph         = df.lon_ph[i];
-            p[i].x_atc          = df.x_atc[i];
-            p[i].h_ph           = df.ellipse_h[i];
-            p[i].geoid          = df.ellipse_h[i] - df.geoid_corr_h[i];
-            p[i].quality_ph     = df.quality_ph[i];
-            p[i].spot           = df.spot.value;
+            batch_time = classifyBatched(df, model->getFilename(), batch_classification);
         }
+        catch(const std::exception& e)
+        {
+            batch_error = e.what();
+        }
+        arena = Atl24Arena::acquire(num_rows);
+    }
 
-        // ENTER conditional serialized execution
-        if(serialize) experiment.lock();
-
-        // classify photons
-        const ATL24::xgboost::ClassificationResult classification = ATL24::main_pipeline::classify (p, model_filename.c_str(), true, ensemble_params);
-        if(classification.labels.size() != num_rows) throw RunTimeException(CRITICAL, RTE_FAILURE, "size mismatch in returned labels: %lu != %lu", classification.labels.size(), num_rows);
-        for(size_t i = 0; i < classification.labels.size(); i++) // class_ph and labels needs to be populated for kd and surface roughness algorithms
+    // wait for admission against memory and cpu budgets (given up if the deadline passes first)
+    Atl24Scheduler::ticket_t ticket = {-1, 0, 0, 0.0};
+    if(!cached && batch_error.empty() && !deadline.expired())
+    {
+        ticket = Atl24Scheduler::admit(df.length(), &deadline);
+        if(ticket.id >= 0)
         {
-            p[i].class_ph = classification.labels[i];
-            p[i].label    = static_cast<ATL24::photon::Label>(classification.labels[i]);
+            mlog(INFO, "Running classifier on spot %d with %ld threads after waiting %.3lf seconds in queue", df.spot.value, ticket.threads, ticket.wait);
+            omp_set_num_threads(ticket.threads); // limits predictor threads started from this thread
         }
+    }
+    const double run_start = TimeLib::latchtime();
+    bool cancelled = false;
 
-        // generate sea surface elevation
-        const vector<ATL24::elevations::Elevations> elevations = ATL24::elevations::get_elevations (p, elevations_params);
-        if(elevations.size() != num_rows) throw RunTimeException(CRITICAL, RTE_FAILURE, "size mismatch in returned elevations: %lu != %lu", elevations.size(), num_rows);
+    try
+    {
+        results_t& results = arena->results;
+        if(!cached)
+        {
+            if(!batch_error.empty()) throw RunTimeException(CRITICAL, RTE_FAILURE, "%s", batch_error.c_str());
+            if(ticket.id < 0) throw RunTimeException(WARNING, RTE_TIMEOUT, "cancelled before admission");
 
-        // estimate kd
-        const vector<double> kd_estimates = ATL24::estimate_kd::classify (p, estimate_kd_params);
-        if(kd_estimates.size() != num_rows) throw RunTimeException(CRITICAL, RTE_FAILURE, "size mismatch in returned kd estimates: %lu != %lu", kd_estimates.size(), num_rows);
+            // check classifier model
+            if(!model) throw RunTimeException(CRITICAL, RTE_FAILURE, "classifier model unavailable");
 
-        // estimate surface roughness
-        const vector<double> estimated_surface_roughness = ATL24::estimate_surface_roughness::classify (p, estimate_surface_roughness_params);
-        if(estimated_surface_roughness.size() != num_rows) throw RunTimeException(CRITICAL, RTE_FAILURE, "size mismatch in returned estimated surface roughness: %lu != %lu", estimated_surface_roughness.size(), num_rows);
+            // allocate results
+            results.class_ph.resize(num_rows);
+            results.confidence.resize(num_rows);
+            results.surface_h.resize(num_rows);
+            results.kd.resize(num_rows);
+            results.surface_roughness.resize(num_rows);
 
-        // EXIT conditional serialized execution
-        if(serialize) experiment.unlock();
+            // split long beams into along-track chunks
+            vector<chunk_t> chunks;
+            if(chunkSize > 0 && num_rows > static_cast<size_t>(chunkSize))
+            {
+                if(!buildChunks(df.x_atc, num_rows, static_cast<size_t>(chunkSize), chunkHalo, chunks))
+                {
+                    mlog(WARNING, "Photons on spot %d are not ordered along-track, classifying in a single pass", df.spot.value);
+                    chunks.clear();
+                }
+            }
 
-        // update new dataframe columns
-        for(size_t i=0; i < num_rows; i++)
-        {
-            class_ph->append(classification.labels[i]);
-            confidence->append(classification.probabilities[i][ATL24::labeling::label_map.at(static_cast<int>(ATL24::photon::Label::bathy))]);
-            surface_h->append(static_cast<float>(elevations[i].sea_surface_elevation));
-            kd->append(static_cast<float>(kd_estimates[i]));
-            surface_roughness->append(static_cast<float>(estimated_surface_roughness[i]));
+            if(chunks.empty())
+            {
+                // classify entire beam in a single pass
+                const double start = TimeLib::latchtime();
+                vector<ATL24::photon::Photon>& p = arena->photons;
+                Atl24Photons::fromBathy(df, p);
+                times.photons += TimeLib::latchtime() - start;
+                classifyPhotons(p, model->getFilename(), results, 0, num_rows, 0, times, ticket.threads >= 3, batched ? &batch_classification : NULL, &deadline);
+                times.classify += batch_time; // only the beam that ran its batch spent time in the classifier
+            }
+            else
+            {
+                // classify chunks concurrently (each chunk reads its window directly from the dataframe)
+                chunk_work_t work;
+                work.df = &df;
+                work.chunks = &chunks;
+                work.model_filename = model->getFilename();
+                work.results = &results;
+                work.deadline = &deadline;
+                work.next_chunk = 0;
+                work.times = times;
+                const long num_threads = MIN(static_cast<long>(chunks.size()), ticket.threads);
+                work.predictor_threads = MAX(ticket.threads / num_threads, 1L);
+                mlog(INFO, "Classifying spot %d in %lu chunks using %ld threads with %ld predictor threads each", df.spot.value, chunks.size(), num_threads, work.predictor_threads);
+                vector<Thread*> threads;
+                for(long t = 0; t < num_threads; t++)
+                {
+                    threads.push_back(new Thread(chunk_thread, &work));
+                }
+                for(Thread* thread: threads)
+                {
+                    delete thread; // joins
+                }
+                if(!work.error.empty()) throw RunTimeException(CRITICAL, RTE_FAILURE, "chunked classification failed: %s", work.error.c_str());
+                times = work.times; // summed across threads
+            }
+
+            // keep results for a later run of the same beam
+            if(!cache_key.empty()) Atl24Cache::store(df, cache_key, results);
         }
 
+        // update new dataframe columns (each result is emptied once copied)
+        const double populate_start = TimeLib::latchtime();
+        populate(class_ph, results.class_ph);
+        populate(confidence, results.confidence);
+        populate(surface_h, results.surface_h);
+        populate(kd, results.kd);
+        populate(surface_roughness, results.surface_roughness);
+        populate_time = TimeLib::latchtime() - populate_start;
+
         // status of completion
-        mlog(INFO, "Finished classifier on spot %d with %lu rows", df.spot.value, num_rows);
+        run_time = TimeLib::latchtime() - run_start;
+        mlog(INFO, "Finished classifier on spot %d with %lu rows in %.3lf seconds (%.0lf photons/sec): photons=%.3lf classify=%.3lf elevations=%.3lf kd=%.3lf roughness=%.3lf columns=%.3lf",
+            df.spot.value, num_rows, run_time, run_time > 0.0 ? num_rows / run_time : 0.0,
+            times.photons, times.classify, times.elevations, times.kd, times.roughness, populate_time);
 
     }
     catch(const std::exception& e)
     {
         status = false;
-        mlog(CRITICAL, "Failed to run classifier on %s spot %d: %s", df.granule.value.c_str(), df.spot.value, e.what());
+        cancelled = deadline.expired(); // no one is waiting on the results, so this is not reported as a failure
+        if(cancelled) mlog(WARNING, "Cancelled classifier on %s spot %d: %s", df.granule.value.c_str(), df.spot.value, e.what());
+        else mlog(CRITICAL, "Failed to run classifier on %s spot %d: %s", df.granule.value.c_str(), df.spot.value, e.what());
     }
 
+    // release working buffers and admission
+    Atl24Arena::release(arena);
+    if(ticket.id >= 0) Atl24Scheduler::release(ticket);
+
     // add columns to dataframe
     df.addExistingColumn("class_ph",            class_ph,           "photon classification");
     df.addExistingColumn("confidence",          confidence,         "bathymetry classification probability");
@@ -200,6 +759,75 @@ bool Atl24Runner::run (GeoDataFrame* dataframe)
     df.addExistingColumn("kd",                  kd,                 "turbidity");
     df.addExistingColumn("surface_roughness",   surface_roughness,  "surface roughness");
 
+    // add metadata to dataframe
+    const struct {
+        const char* name;
+        double      value;
+        const char* desc;
+    } timing[] = {
+        {"queue_wait",          ticket.wait,        "seconds spent waiting for admission to run classifier"},
+        {"threads",             static_cast<double>(ticket.threads), "cpus assigned to beam by scheduler"},
+        {"cached",              cached ? 1.0 : 0.0, "classifier results loaded from cache instead of computed"},
+        {"cancelled",           cancelled ? 1.0 : 0.0, "classifier stopped at request deadline or cancellation, columns are incomplete"},
+        {"time_photons",        times.photons,      "seconds spent converting dataframe to photons (summed across chunks)"},
+        {"time_classify",       times.classify,     "seconds spent in classifier (summed across chunks)"},
+        {"time_elevations",     times.elevations,   "seconds spent generating sea surface elevations (summed across chunks)"},
+        {"time_kd",             times.kd,           "seconds spent estimating kd (summed across chunks)"},
+        {"time_roughness",      times.roughness,    "seconds spent estimating surface roughness (summed across chunks)"},
+        {"time_columns",        populate_time,      "seconds spent populating dataframe columns"},
+        {"time_run",            run_time,           "wall clock seconds spent running classifier after admission"},
+        {"photon_rate",         run_time > 0.0 ? num_rows / run_time : 0.0, "photons classified per wall clock second"}
+    };
+    for(const auto& entry: timing)
+    {
+        FieldElement<double>* element = new FieldElement<double>(entry.value);
+        if(!df.addMetaData(entry.name, element, StringLib::duplicate(entry.desc), true))
+        {
+            mlog(CRITICAL, "Failed to add metadata to dataframe");
+            delete element;
+        }
+    }
+
     // return success
     return status;
 }
+
+/*----------------------------------------------------------------------------
+ * luaDeadline - :deadline(<timeout ms>) - beams still classifying after timeout are cancelled
+ *
+ *  a negative timeout clears the deadline; either way a previous cancel is
+ *  cleared so a runner shared across requests can be armed for each one
+ *----------------------------------------------------------------------------*/
+int Atl24Runner::luaDeadline (lua_State* L)
+{
+    try
+    {
+        Atl24Runner* lua_obj = dynamic_cast<Atl24Runner*>(getLuaSelf(L, 1));
+        const long timeout_ms = getLuaInteger(L, 2);
+        lua_obj->deadline.set(timeout_ms);
+        return returnLuaStatus(L, true);
+    }
+    catch(const RunTimeException& e)
+    {
+        mlog(e.level(), "Error setting deadline: %s", e.what());
+        return returnLuaStatus(L, false);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * luaCancel - :cancel() - stops beams waiting for or running the classifier
+ *----------------------------------------------------------------------------*/
+int Atl24Runner::luaCancel (lua_State* L)
+{
+    try
+    {
+        Atl24Runner* lua_obj = dynamic_cast<Atl24Runner*>(getLuaSelf(L, 1));
+        lua_obj->deadline.cancel();
+        return returnLuaStatus(L, true);
+    }
+    catch(const RunTimeException& e)
+    {
+        mlog(e.level(), "Error cancelling classifier: %s", e.what());
+        return returnLuaStatus(L, false);
+    }
+}
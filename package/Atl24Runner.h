@@ -32,10 +32,16 @@
 #ifndef __atl24_runner__
 #define __atl24_runner__
 
+#include <map>
+
+#include "photon.h" // ATL24
+#include "xgboost.h" // ATL24
+
 #include "OsApi.h"
 #include "GeoDataFrame.h"
 #include "Icesat2Parameters.h"
 #include "BathyDataFrame.h"
+#include "Atl24Deadline.h"
 
 /******************************************************************************
  * CLASS
@@ -52,31 +58,129 @@ class Atl24Runner: public GeoDataFrame::FrameRunner
         static const char* LUA_META_NAME;
         static const struct luaL_Reg LUA_META_TABLE[];
 
-        static const long DEFAULT_SERIALIZE_THRESHOLD = 500000;
+        static const long DEFAULT_CHUNK_SIZE = 0; // photons per along-track chunk, 0 disables chunking (results near chunk edges are approximate)
+        static constexpr double DEFAULT_CHUNK_HALO = 1000.0; // meters of context on each side of a chunk
+        static const long DEFAULT_BATCH_BEAMS = 0; // beams classified in one predictor call, 0 disables batching
+        static const int BATCH_WAIT_MS = 10000; // longest a beam waits for the rest of its batch (before admission)
+        static constexpr double BATCH_GAP = 100000.0; // meters between beams placed in the same batch
+
+        /*--------------------------------------------------------------------
+         * Typedefs
+         *--------------------------------------------------------------------*/
+
+        typedef struct {
+            vector<int>     class_ph;
+            vector<float>   confidence;
+            vector<float>   surface_h;
+            vector<float>   kd;
+            vector<float>   surface_roughness;
+        } results_t;
+
+        typedef struct {
+            size_t          window_start;   // first photon given to the algorithms
+            size_t          window_stop;    // one past last photon given to the algorithms
+            size_t          core_start;     // first photon whose results are kept
+            size_t          core_stop;      // one past last photon whose results are kept
+        } chunk_t;
+
+        typedef struct {
+            double          photons;        // conversion from dataframe to photon structures
+            double          classify;       // main_pipeline::classify
+            double          elevations;     // elevations::get_elevations
+            double          kd;             // estimate_kd::classify
+            double          roughness;      // estimate_surface_roughness::classify
+        } stage_times_t;
+
+        typedef struct {
+            vector<int>                             labels;
+            vector<float>                           bathy_prob;     // only probability column kept from classifier
+        } classification_t;
 
         /*--------------------------------------------------------------------
          * Methods
          *--------------------------------------------------------------------*/
 
-        static int      luaCreate   (lua_State* L);
-        bool            run         (GeoDataFrame* dataframe) override;
+        static int      luaCreate       (lua_State* L);
+        template<class X>
+        static bool     buildChunks     (X& x_atc, size_t num_rows, size_t chunk_size, double chunk_halo, vector<chunk_t>& chunks);
+        static void     classifyPhotons (vector<ATL24::photon::Photon>& p, const char* model_filename, results_t& results, size_t core_start, size_t core_stop, size_t dest, stage_times_t& times, bool concurrent, const classification_t* classified=NULL, const Atl24Deadline* deadline=NULL);
+        static classification_t classifySingle (vector<ATL24::photon::Photon>& p, const char* model_filename);
+        static void     classifyBatch   (const vector<vector<ATL24::photon::Photon>*>& beams, const char* model_filename, vector<classification_t>& classifications);
+        bool            run             (GeoDataFrame* dataframe) override;
 
     private:
 
+        /*--------------------------------------------------------------------
+         * Typedefs
+         *--------------------------------------------------------------------*/
+
+        typedef struct {
+            BathyDataFrame*                         df;
+            classification_t                        classification;
+            bool                                    done;
+            string                                  error;
+        } batch_entry_t;
+
         /*--------------------------------------------------------------------
          * Methods
          *--------------------------------------------------------------------*/
 
-        Atl24Runner  (lua_State* L, Icesat2Parameters* _parms, long _serialize_threshold);
+        Atl24Runner  (lua_State* L, Icesat2Parameters* _parms, long _chunk_size, double _chunk_halo, long _batch_beams);
         ~Atl24Runner (void) override;
 
+        static void             compact         (ATL24::xgboost::ClassificationResult& result, size_t offset, size_t n, classification_t& classification);
+        double                  classifyBatched (BathyDataFrame& df, const char* model_filename, classification_t& classification);
+        static int              luaDeadline     (lua_State* L);
+        static int              luaCancel       (lua_State* L);
+
         /*--------------------------------------------------------------------
          * Data
          *--------------------------------------------------------------------*/
 
         Icesat2Parameters*  parms;
-        long                serializeThreshold;
-        Mutex               experiment;
+        long                chunkSize;
+        double              chunkHalo;
+        long                batchBeams;
+        Cond                batchCond;
+        std::map<string, vector<batch_entry_t*>> batchPending; // beams waiting for a batch, by granule
+        Atl24Deadline       deadline;
 };
 
+/******************************************************************************
+ * TEMPLATE METHODS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * buildChunks - splits beam into along-track windows with halo on each side
+ *
+ *  returns false if photons are not ordered by x_atc, in which case the beam
+ *  cannot be windowed and must be processed in a single pass
+ *----------------------------------------------------------------------------*/
+template<class X>
+bool Atl24Runner::buildChunks (X& x_atc, size_t num_rows, size_t chunk_size, double chunk_halo, vector<chunk_t>& chunks)
+{
+    // check ordering
+    for(size_t i = 1; i < num_rows; i++)
+    {
+        if(x_atc[i] < x_atc[i-1]) return false;
+    }
+
+    // build windows
+    size_t window_start = 0;
+    size_t window_stop = 0;
+    for(size_t core_start = 0; core_start < num_rows; core_start += chunk_size)
+    {
+        const size_t core_stop = MIN(core_start + chunk_size, num_rows);
+        const double start_x = x_atc[core_start] - chunk_halo;
+        const double stop_x = x_atc[core_stop - 1] + chunk_halo;
+        while(x_atc[window_start] < start_x) window_start++;
+        if(window_stop < core_stop) window_stop = core_stop;
+        while(window_stop < num_rows && x_atc[window_stop] <= stop_x) window_stop++;
+        const chunk_t chunk = {window_start, window_stop, core_start, core_stop};
+        chunks.push_back(chunk);
+    }
+
+    return true;
+}
+
 #endif
\ No newline at end of file
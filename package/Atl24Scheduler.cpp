@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <unistd.h>
+
+#include "OsApi.h"
+#include "TimeLib.h"
+#include "LuaEngine.h"
+#include "Atl24Scheduler.h"
+
+/******************************************************************************
+ * DATA
+ ******************************************************************************/
+
+const double Atl24Scheduler::DEFAULT_MEMORY_FRACTION = 0.75;
+
+Cond Atl24Scheduler::admission;
+std::list<Atl24Scheduler::waiter_t> Atl24Scheduler::waiters;
+long Atl24Scheduler::nextId = 0;
+int64_t Atl24Scheduler::memoryBudget = 0;
+long Atl24Scheduler::cpuBudget = 1;
+long Atl24Scheduler::bytesPerPhoton = DEFAULT_BYTES_PER_PHOTON;
+int64_t Atl24Scheduler::memoryInUse = 0;
+long Atl24Scheduler::running = 0;
+long Atl24Scheduler::threadsInUse = 0;
+long Atl24Scheduler::maxThreadsPerBeam = 0;
+
+/******************************************************************************
+ * METHODS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * init
+ *----------------------------------------------------------------------------*/
+void Atl24Scheduler::init (void)
+{
+    memoryBudget = static_cast<int64_t>(memoryLimit() * DEFAULT_MEMORY_FRACTION);
+    cpuBudget = sysconf(_SC_NPROCESSORS_ONLN);
+    if(cpuBudget < 1) cpuBudget = 1;
+    print2term("Beam scheduler budget: %ld MB, %ld cpus\n", static_cast<long>(memoryBudget / 0x100000), cpuBudget);
+}
+
+/*----------------------------------------------------------------------------
+ * admit - blocks until beam fits within memory and cpu budgets
+ *
+ *  the admitted beam is assigned an even share of the cpu budget across the
+ *  beams of a granule, regardless of how many are waiting when it arrives,
+ *  and is held in line until that share is free, so the threads of all
+ *  running beams stay within the cpu budget; a batch of beams that are
+ *  classified together is admitted as one and given the share of all of
+ *  its beams; a beam whose deadline passes while it waits leaves the line
+ *  without claiming anything and is returned a ticket with a negative id,
+ *  which is not released
+ *----------------------------------------------------------------------------*/
+Atl24Scheduler::ticket_t Atl24Scheduler::admit (long num_rows, const Atl24Deadline* deadline, long num_beams)
+{
+    const double start = TimeLib::latchtime();
+    ticket_t ticket;
+
+    admission.lock();
+    {
+        /* estimate working set - capped so oversized beams can still run on their own */
+        int64_t estimate = static_cast<int64_t>(num_rows) * bytesPerPhoton;
+        if(estimate > memoryBudget) estimate = memoryBudget;
+
+        /* wait in line */
+        const waiter_t waiter = {nextId++, estimate, num_beams};
+        waiters.push_back(waiter);
+        bool cancelled = false;
+        while(!admissible(waiter))
+        {
+            if(deadline && deadline->expired())
+            {
+                cancelled = true;
+                break;
+            }
+            admission.wait(0, deadline ? Atl24Deadline::POLL_MS : IO_PEND);
+        }
+        waiters.remove_if([&waiter](const waiter_t& w) { return w.id == waiter.id; });
+
+        if(!cancelled)
+        {
+            /* claim resources */
+            const long threads = threadShare(num_beams);
+            memoryInUse += waiter.estimate;
+            threadsInUse += threads;
+            running++;
+            ticket.id = waiter.id;
+            ticket.estimate = waiter.estimate;
+            ticket.threads = threads;
+        }
+        else
+        {
+            /* left the line without claiming anything */
+            ticket.id = -1;
+            ticket.estimate = 0;
+            ticket.threads = 0;
+        }
+
+        /* others may now be admissible (e.g. if the head of the line changed) */
+        admission.signal(0, Cond::NOTIFY_ALL);
+    }
+    admission.unlock();
+
+    ticket.wait = TimeLib::latchtime() - start;
+    return ticket;
+}
+
+/*----------------------------------------------------------------------------
+ * release
+ *----------------------------------------------------------------------------*/
+void Atl24Scheduler::release (const ticket_t& ticket)
+{
+    admission.lock();
+    {
+        memoryInUse -= ticket.estimate;
+        threadsInUse -= ticket.threads;
+        running--;
+        admission.signal(0, Cond::NOTIFY_ALL);
+    }
+    admission.unlock();
+}
+
+/*----------------------------------------------------------------------------
+ * getCpuBudget
+ *----------------------------------------------------------------------------*/
+long Atl24Scheduler::getCpuBudget (void)
+{
+    return cpuBudget;
+}
+
+/*----------------------------------------------------------------------------
+ * luaConfig - scheduler([<memory budget MB>], [<cpu budget>], [<bytes per photon>], [<max threads per beam>])
+ *----------------------------------------------------------------------------*/
+int Atl24Scheduler::luaConfig (lua_State* L)
+{
+    try
+    {
+        const long memory_mb = LuaObject::getLuaInteger(L, 1, true, 0);
+        const long cpus = LuaObject::getLuaInteger(L, 2, true, 0);
+        const long bytes_per_photon = LuaObject::getLuaInteger(L, 3, true, 0);
+        const long max_threads_per_beam = LuaObject::getLuaInteger(L, 4, true, -1);
+
+        admission.lock();
+        {
+            /* update budgets */
+            if(memory_mb > 0) memoryBudget = static_cast<int64_t>(memory_mb) * 0x100000;
+            if(cpus > 0) cpuBudget = cpus;
+            if(bytes_per_photon > 0) bytesPerPhoton = bytes_per_photon;
+            if(max_threads_per_beam >= 0) maxThreadsPerBeam = max_threads_per_beam;
+            admission.signal(0, Cond::NOTIFY_ALL);
+
+            /* return current state */
+            lua_newtable(L);
+            LuaEngine::setAttrInt(L, "memory_budget", memoryBudget);
+            LuaEngine::setAttrInt(L, "cpu_budget", cpuBudget);
+            LuaEngine::setAttrInt(L, "bytes_per_photon", bytesPerPhoton);
+            LuaEngine::setAttrInt(L, "max_threads_per_beam", maxThreadsPerBeam);
+            LuaEngine::setAttrInt(L, "threads_in_use", threadsInUse);
+            LuaEngine::setAttrInt(L, "memory_in_use", memoryInUse);
+            LuaEngine::setAttrInt(L, "running", running);
+            LuaEngine::setAttrInt(L, "waiting", waiters.size());
+        }
+        admission.unlock();
+        return 1;
+    }
+    catch(const RunTimeException& e)
+    {
+        mlog(e.level(), "Error configuring beam scheduler: %s", e.what());
+        return LuaObject::returnLuaStatus(L, false);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * admissible - must be called with admission locked
+ *
+ *  A beam runs when its thread share and memory estimate fit within the
+ *  remaining budgets.  Beams behind the head of the line may run ahead of it
+ *  only if they leave enough memory for it, so small beams fill in around a
+ *  large one without starving it.  A beam is always admitted when nothing
+ *  else is running.
+ *----------------------------------------------------------------------------*/
+bool Atl24Scheduler::admissible (const waiter_t& waiter)
+{
+    if(running == 0) return true;
+    if(threadsInUse + threadShare(waiter.num_beams) > cpuBudget) return false;
+    if(memoryInUse + waiter.estimate > memoryBudget) return false;
+    const waiter_t& head = waiters.front();
+    if(head.id == waiter.id) return true;
+    return memoryInUse + waiter.estimate + head.estimate <= memoryBudget;
+}
+
+/*----------------------------------------------------------------------------
+ * threadShare - must be called with admission locked
+ *----------------------------------------------------------------------------*/
+long Atl24Scheduler::threadShare (long num_beams)
+{
+    long threads = (cpuBudget * num_beams) / EXPECTED_BEAMS;
+    if(maxThreadsPerBeam > 0) threads = MIN(threads, maxThreadsPerBeam * num_beams);
+    threads = MIN(threads, cpuBudget);
+    if(threads < 1) threads = 1;
+    return threads;
+}
+
+/*----------------------------------------------------------------------------
+ * memoryLimit - container memory limit if set, otherwise physical memory
+ *----------------------------------------------------------------------------*/
+int64_t Atl24Scheduler::memoryLimit (void)
+{
+    const int64_t physical = static_cast<int64_t>(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGE_SIZE);
+    int64_t limit = physical;
+
+    fileptr_t file = fopen("/sys/fs/cgroup/memory.max", "r");
+    if(file)
+    {
+        long long value = 0;
+        if(fscanf(file, "%lld", &value) == 1 && value > 0 && value < physical)
+        {
+            limit = value;
+        }
+        fclose(file);
+    }
+
+    return limit;
+}
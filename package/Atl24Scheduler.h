@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __atl24_scheduler__
+#define __atl24_scheduler__
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <list>
+
+#include "OsApi.h"
+#include "LuaEngine.h"
+#include "Atl24Deadline.h"
+
+/******************************************************************************
+ * CLASS
+ ******************************************************************************/
+
+class Atl24Scheduler
+{
+    public:
+
+        /*--------------------------------------------------------------------
+         * Constants
+         *--------------------------------------------------------------------*/
+
+        static const long   DEFAULT_BYTES_PER_PHOTON = 1024; // estimated peak working set of classifier per photon
+        static const double DEFAULT_MEMORY_FRACTION; // portion of container memory available to beams
+        static const long   EXPECTED_BEAMS = 6; // beams of a granule expected to run at the same time
+
+        /*--------------------------------------------------------------------
+         * Typedefs
+         *--------------------------------------------------------------------*/
+
+        typedef struct {
+            long    id;         // negative when the beam was not admitted
+            int64_t estimate;   // bytes reserved against memory budget
+            long    threads;    // cpus assigned to beam out of cpu budget
+            double  wait;       // seconds spent in admission queue
+        } ticket_t;
+
+        /*--------------------------------------------------------------------
+         * Methods
+         *--------------------------------------------------------------------*/
+
+        static void     init        (void);
+        static ticket_t admit       (long num_rows, const Atl24Deadline* deadline=NULL, long num_beams=1);
+        static void     release     (const ticket_t& ticket);
+        static long     getCpuBudget(void);
+        static int      luaConfig   (lua_State* L);
+
+    private:
+
+        /*--------------------------------------------------------------------
+         * Typedefs
+         *--------------------------------------------------------------------*/
+
+        typedef struct {
+            long    id;
+            int64_t estimate;
+            long    num_beams;
+        } waiter_t;
+
+        /*--------------------------------------------------------------------
+         * Methods
+         *--------------------------------------------------------------------*/
+
+        static bool     admissible  (const waiter_t& waiter);
+        static long     threadShare (long num_beams);
+        static int64_t  memoryLimit (void);
+
+        /*--------------------------------------------------------------------
+         * Data
+         *--------------------------------------------------------------------*/
+
+        static Cond                 admission;
+        static std::list<waiter_t>  waiters;
+        static long                 nextId;
+        static int64_t              memoryBudget;
+        static long                 cpuBudget;
+        static long                 bytesPerPhoton;
+        static int64_t              memoryInUse;
+        static long                 running;
+        static long                 threadsInUse;
+        static long                 maxThreadsPerBeam; // 0 is no limit
+};
+
+#endif  /* __atl24_scheduler__ */
@@ -0,0 +1,433 @@
+/*
+ * Copyright (c) 2021, University of Washington
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the University of Washington nor the names of its
+ *    contributors may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY OF WASHINGTON AND CONTRIBUTORS
+ * “AS IS” AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE UNIVERSITY OF WASHINGTON OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/******************************************************************************
+ * INCLUDES
+ ******************************************************************************/
+
+#include <math.h>
+#include <time.h>
+
+#include "OsApi.h"
+#include "FieldElement.h"
+#include "FieldColumn.h"
+#include "Atl24Stats.h"
+
+/******************************************************************************
+ * DATA
+ ******************************************************************************/
+
+const char* Atl24Stats::LUA_META_NAME = "Atl24Stats";
+const struct luaL_Reg Atl24Stats::LUA_META_TABLE[] = {
+    {NULL,          NULL}
+};
+
+/******************************************************************************
+ * LOCAL TYPES
+ ******************************************************************************/
+
+/* running mean and variance (Welford) with extremes */
+typedef struct {
+    int64_t n;
+    double  mean;
+    double  m2;     // sum of squared differences from the mean
+    double  min;
+    double  max;
+} running_t;
+
+typedef struct {
+    double  lon;
+    double  lat;
+} point_t;
+
+/******************************************************************************
+ * LOCAL FUNCTIONS
+ ******************************************************************************/
+
+/*----------------------------------------------------------------------------
+ * accumulate
+ *----------------------------------------------------------------------------*/
+static void accumulate (running_t& r, double value)
+{
+    if(isnan(value)) return;
+    r.n++;
+    const double delta = value - r.mean;
+    r.mean += delta / r.n;
+    r.m2 += delta * (value - r.mean);
+    if(r.n == 1 || value < r.min) r.min = value;
+    if(r.n == 1 || value > r.max) r.max = value;
+}
+
+/*----------------------------------------------------------------------------
+ * sample_std - matches pandas (one degree of freedom), NaN below two values
+ *----------------------------------------------------------------------------*/
+static double sample_std (const running_t& r)
+{
+    return r.n > 1 ? sqrt(r.m2 / (r.n - 1)) : NAN;
+}
+
+/*----------------------------------------------------------------------------
+ * json_number - NaN as null
+ *----------------------------------------------------------------------------*/
+static string json_number (double value)
+{
+    if(isnan(value)) return "null";
+    return FString("%.6lf", value).c_str();
+}
+
+/*----------------------------------------------------------------------------
+ * iso_time - unix nanoseconds as UTC ISO 8601
+ *----------------------------------------------------------------------------*/
+static string iso_time (int64_t nanoseconds)
+{
+    const time_t seconds = static_cast<time_t>(nanoseconds / 1000000000LL);
+    const long microseconds = static_cast<long>((nanoseconds % 1000000000LL) / 1000LL);
+    struct tm gmt;
+    gmtime_r(&seconds, &gmt);
+    return FString("%04d-%02d-%02dT%02d:%02d:%02d.%06ldZ", gmt.tm_year + 1900, gmt.tm_mon + 1, gmt.tm_mday, gmt.tm_hour, gmt.tm_min, gmt.tm_sec, microseconds).c_str();
+}
+
+/*----------------------------------------------------------------------------
+ * season - 0: winter, 1: spring, 2: summer, 3: fall
+ *
+ *  regions 1 through 7 are in the northern hemisphere
+ *----------------------------------------------------------------------------*/
+static int season (int month, int region)
+{
+    static const int north[12] = {0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3};
+    static const int south[12] = {2, 2, 2, 3, 3, 3, 0, 0, 0, 1, 1, 1};
+    if(month < 1 || month > 12) return -1;
+    return region < 8 ? north[month - 1] : south[month - 1];
+}
+
+/*----------------------------------------------------------------------------
+ * simplify - Douglas-Peucker reduction of track to within tolerance
+ *----------------------------------------------------------------------------*/
+static void simplify (const vector<point_t>& track, double tolerance, vector<point_t>& reduced)
+{
+    const size_t n = track.size();
+    if(n <= 2)
+    {
+        reduced = track;
+        return;
+    }
+
+    vector<bool> keep(n, false);
+    keep[0] = true;
+    keep[n - 1] = true;
+    vector<std::pair<size_t, size_t>> spans = {{0, n - 1}};
+    while(!spans.empty())
+    {
+        const size_t first = spans.back().first;
+        const size_t last = spans.back().second;
+        spans.pop_back();
+
+        const double dx = track[last].lon - track[first].lon;
+        const double dy = track[last].lat - track[first].lat;
+        const double length = sqrt((dx * dx) + (dy * dy));
+        double farthest = 0.0;
+        size_t index = first;
+        for(size_t i = first + 1; i < last; i++)
+        {
+            const double px = track[i].lon - track[first].lon;
+            const double py = track[i].lat - track[first].lat;
+            const double distance = length > 0.0 ? fabs((dx * py) - (dy * px)) / length : sqrt((px * px) + (py * py));
+            if(distance > farthest)
+            {
+                farthest = distance;
+                index = i;
+            }
+        }
+
+        if(farthest > tolerance)
+        {
+            keep[index] = true;
+            spans.emplace_back(first, index);
+            spans.emplace_back(index, last);
+        }
+    }
+
+    reduced.clear();
+    for(size_t i = 0; i < n; i++)
+    {
+        if(keep[i]) reduced.push_back(track[i]);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * footprint - simplified ground track buffered on both sides
+ *
+ *  a beam is a line of photons, so its footprint is the corridor around the
+ *  simplified track: the track is offset by the tolerance to either side
+ *  and extended by it at each end; returned as "lon lat lon lat ..." with
+ *  the first point repeated at the end
+ *----------------------------------------------------------------------------*/
+static string footprint (const vector<point_t>& track, double tolerance)
+{
+    if(track.empty()) return "";
+
+    vector<point_t> line;
+    simplify(track, tolerance, line);
+    if(line.size() == 1) line.push_back(line[0]); // single location is buffered into a square
+
+    const size_t n = line.size();
+    vector<point_t> left(n);
+    vector<point_t> right(n);
+    for(size_t i = 0; i < n; i++)
+    {
+        /* direction of track through vertex */
+        const point_t& prev = line[i > 0 ? i - 1 : i];
+        const point_t& next = line[i < n - 1 ? i + 1 : i];
+        double dx = next.lon - prev.lon;
+        double dy = next.lat - prev.lat;
+        double length = sqrt((dx * dx) + (dy * dy));
+        if(length <= 0.0)
+        {
+            dx = 0.0;
+            dy = 1.0;
+            length = 1.0;
+        }
+        dx /= length;
+        dy /= length;
+
+        /* extend ends along the track */
+        point_t center = line[i];
+        if(i == 0)
+        {
+            center.lon -= dx * tolerance;
+            center.lat -= dy * tolerance;
+        }
+        if(i == n - 1)
+        {
+            center.lon += dx * tolerance;
+            center.lat += dy * tolerance;
+        }
+
+        left[i] = {center.lon - (dy * tolerance), center.lat + (dx * tolerance)};
+        right[i] = {center.lon + (dy * tolerance), center.lat - (dx * tolerance)};
+    }
+
+    string polygon;
+    for(size_t i = 0; i < n; i++)
+    {
+        polygon += FString("%.6lf %.6lf ", left[i].lon, left[i].lat).c_str();
+    }
+    for(size_t i = n; i > 0; i--)
+    {
+        polygon += FString("%.6lf %.6lf ", right[i - 1].lon, right[i - 1].lat).c_str();
+    }
+    polygon += FString("%.6lf %.6lf", left[0].lon, left[0].lat).c_str();
+
+    return polygon;
+}
+
+/*----------------------------------------------------------------------------
+ * add_meta
+ *----------------------------------------------------------------------------*/
+template<class T>
+static void add_meta (BathyDataFrame& df, const char* name, const T& value, const char* desc)
+{
+    FieldElement<T>* element = new FieldElement<T>(value);
+    if(!df.addMetaData(name, element, StringLib::duplicate(desc), true))
+    {
+        mlog(CRITICAL, "Failed to add %s metadata to dataframe", name);
+        delete element;
+    }
+}
+
+/******************************************************************************
+ * METHODS
+ ******************************************************************************/
+
+ /*----------------------------------------------------------------------------
+ * luaCreate - stats(<parms>)
+ *----------------------------------------------------------------------------*/
+int Atl24Stats::luaCreate (lua_State* L)
+{
+    Icesat2Parameters* _parms = NULL;
+
+    try
+    {
+        _parms = dynamic_cast<Icesat2Parameters*>(getLuaObject(L, 1, Icesat2Parameters::OBJECT_TYPE));
+        return createLuaObject(L, new Atl24Stats(L, _parms));
+    }
+    catch(const RunTimeException& e)
+    {
+        if(_parms) _parms->releaseLuaObject();
+        mlog(e.level(), "Error creating %s: %s", OBJECT_TYPE, e.what());
+        return returnLuaStatus(L, false);
+    }
+}
+
+/*----------------------------------------------------------------------------
+ * Constructor
+ *----------------------------------------------------------------------------*/
+Atl24Stats::Atl24Stats (lua_State* L, Icesat2Parameters* _parms):
+    GeoDataFrame::FrameRunner(L, LUA_META_NAME, LUA_META_TABLE),
+    parms(_parms)
+{
+}
+
+/*----------------------------------------------------------------------------
+ * Destructor
+ *----------------------------------------------------------------------------*/
+Atl24Stats::~Atl24Stats (void)
+{
+    if(parms) parms->releaseLuaObject();
+}
+
+/*----------------------------------------------------------------------------
+ * run - per-beam statistics in a single pass over the photons
+ *
+ *  depth is the sea surface height less the orthometric height; subaqueous
+ *  photons are unclassified or bathymetry photons at or below the surface,
+ *  and the depth histogram covers bathymetry photons in [0, 50] meters with
+ *  the last bin closed
+ *----------------------------------------------------------------------------*/
+bool Atl24Stats::run (GeoDataFrame* dataframe)
+{
+    // cast dataframe to ATL24 specific dataframe
+    BathyDataFrame& df = *dynamic_cast<BathyDataFrame*>(dataframe);
+    const long num_rows = df.length();
+
+    // get columns added by classifier
+    FieldColumn<int>* class_ph = reinterpret_cast<FieldColumn<int>*>(df.getColumn("class_ph", true));
+    FieldColumn<float>* surface_h = reinterpret_cast<FieldColumn<float>*>(df.getColumn("surface_h", true));
+    if(!class_ph || !surface_h)
+    {
+        mlog(CRITICAL, "Unable to generate statistics for spot %d, dataframe is missing classifier columns", df.spot.value);
+        return false;
+    }
+
+    // single pass over photons
+    int64_t subaqueous_photons = 0;
+    int64_t sea_surface_photons = 0;
+    int64_t bathy_photons = 0;
+    int64_t bathy_above_sea_surface = 0;
+    int64_t bathy_below_sensor_depth = 0;
+    int64_t histogram[HISTOGRAM_BINS] = {0};
+    running_t sea_surface = {0, 0.0, 0.0, 0.0, 0.0};
+    running_t bathy = {0, 0.0, 0.0, 0.0, 0.0};
+    vector<point_t> track;
+    point_t last = {0.0, 0.0};
+    for(long i = 0; i < num_rows; i++)
+    {
+        const int cls = (*class_ph)[i];
+        const float ortho_h = df.geoid_corr_h[i];
+        const float depth = (*surface_h)[i] - ortho_h;
+
+        if((cls == UNCLASSIFIED || cls == BATHYMETRY) && depth >= 0.0)
+        {
+            subaqueous_photons++;
+        }
+
+        if(cls == SEA_SURFACE)
+        {
+            sea_surface_photons++;
+            accumulate(sea_surface, ortho_h);
+        }
+        else if(cls == BATHYMETRY)
+        {
+            bathy_photons++;
+            accumulate(bathy, depth);
+            if(depth < 0.0) bathy_above_sea_surface++;
+            if(depth > SENSOR_DEPTH) bathy_below_sensor_depth++;
+            if(depth >= 0.0 && depth <= HISTOGRAM_BINS)
+            {
+                const int bin = MIN(static_cast<int>(depth), HISTOGRAM_BINS - 1);
+                histogram[bin]++;
+            }
+        }
+
+        // thin ground track to a tenth of the footprint tolerance
+        const point_t point = {df.lon_ph[i], df.lat_ph[i]};
+        const double dx = point.lon - last.lon;
+        const double dy = point.lat - last.lat;
+        if(track.empty() || i == num_rows - 1 || sqrt((dx * dx) + (dy * dy)) >= FOOTPRINT_TOLERANCE / 10.0)
+        {
+            track.push_back(point);
+            last = point;
+        }
+    }
+
+    // granule information - ATL03_YYYYMMDDhhmmss_ttttccrr_rrr_vv.h5
+    const string& granule = df.granule.value;
+    const int month = granule.size() > 12 ? atoi(granule.substr(10, 2).c_str()) : 0;
+    const int region = granule.size() > 29 ? atoi(granule.substr(27, 2).c_str()) : 0;
+
+    // build strings
+    string histogram_str;
+    for(int b = 0; b < HISTOGRAM_BINS; b++)
+    {
+        if(b > 0) histogram_str += " ";
+        histogram_str += std::to_string(histogram[b]);
+    }
+    const string polygon = footprint(track, FOOTPRINT_TOLERANCE);
+    const string begin_time = num_rows > 0 ? iso_time(df.time_ns[0].nanoseconds) : "";
+    const string end_time = num_rows > 0 ? iso_time(df.time_ns[num_rows - 1].nanoseconds) : "";
+    const double bathy_mean_depth = bathy.n > 0 ? bathy.mean : NAN;
+    const double bathy_min_depth = bathy.n > 0 ? bathy.min : NAN;
+    const double bathy_max_depth = bathy.n > 0 ? bathy.max : NAN;
+    const double sea_surface_std = sample_std(sea_surface);
+    const double bathy_std_depth = sample_std(bathy);
+
+    // add metadata to dataframe
+    add_meta<int64_t>(df, "total_photons", num_rows, "number of photons in beam");
+    add_meta<int64_t>(df, "subaqueous_photons", subaqueous_photons, "unclassified and bathymetry photons at or below the sea surface");
+    add_meta<int64_t>(df, "sea_surface_photons", sea_surface_photons, "sea surface photons");
+    add_meta<double>(df, "sea_surface_std", sea_surface_std, "standard deviation of sea surface photon orthometric heights");
+    add_meta<int64_t>(df, "bathy_photons", bathy_photons, "bathymetry photons");
+    add_meta<double>(df, "bathy_mean_depth", bathy_mean_depth, "mean depth of bathymetry photons");
+    add_meta<double>(df, "bathy_min_depth", bathy_min_depth, "minimum depth of bathymetry photons");
+    add_meta<double>(df, "bathy_max_depth", bathy_max_depth, "maximum depth of bathymetry photons");
+    add_meta<double>(df, "bathy_std_depth", bathy_std_depth, "standard deviation of bathymetry photon depths");
+    add_meta<int64_t>(df, "bathy_above_sea_surface", bathy_above_sea_surface, "bathymetry photons above the sea surface");
+    add_meta<int64_t>(df, "bathy_below_sensor_depth", bathy_below_sensor_depth, "bathymetry photons deeper than the sensor depth");
+    add_meta<string>(df, "histogram", histogram_str, "bathymetry photons in one meter depth bins from 0 to 50 meters");
+    add_meta<string>(df, "polygon", polygon, "simplified footprint of beam as lon lat pairs");
+    add_meta<string>(df, "begin_time", begin_time, "time of first photon in beam");
+    add_meta<string>(df, "end_time", end_time, "time of last photon in beam");
+
+    // all statistics as one document for the writer
+    const FString stats_json("{\"granule\":\"%s\",\"region\":%d,\"season\":%d,\"total_photons\":%ld,\"subaqueous_photons\":%ld,"
+                             "\"sea_surface_photons\":%ld,\"sea_surface_std\":%s,\"bathy_photons\":%ld,\"bathy_mean_depth\":%s,"
+                             "\"bathy_min_depth\":%s,\"bathy_max_depth\":%s,\"bathy_std_depth\":%s,\"bathy_above_sea_surface\":%ld,"
+                             "\"bathy_below_sensor_depth\":%ld,\"histogram\":\"%s\",\"polygon\":\"%s\",\"begin_time\":\"%s\",\"end_time\":\"%s\"}",
+                             granule.c_str(), region, season(month, region), static_cast<long>(num_rows), static_cast<long>(subaqueous_photons),
+                             static_cast<long>(sea_surface_photons), json_number(sea_surface_std).c_str(), static_cast<long>(bathy_photons), json_number(bathy_mean_depth).c_str(),
+                             json_number(bathy_min_depth).c_str(), json_number(bathy_max_depth).c_str(), json_number(bathy_std_depth).c_str(), static_cast<long>(bathy_above_sea_surface),
+                             static_cast<long>(bathy_below_sensor_depth), histogram_str.c_str(), polygon.c_str(), begin_time.c_str(), end_time.c_str());
+    add_meta<string>(df, "stats", stats_json.c_str(), "beam statistics as json");
+
+    mlog(INFO, "Generated statistics for spot %d: %ld photons, %ld bathymetry, %ld sea surface", df.spot.value, num_rows, static_cast<long>(bathy_photons), static_cast<long>(sea_surface_photons));
+
+    return true;
+}
@@ -36,10 +36,12 @@
 #include <cmath>
 #include <numeric>
 #include <algorithm>
+#include <unistd.h>
 
 #include "OsApi.h"
 #include "GeoLib.h"
 #include "Atl24Uncertainty.h"
+#include "Atl24Columns.h"
 #include "BathyParameters.h"
 #include "BathyDataFrame.h"
 
@@ -52,26 +54,8 @@ const struct luaL_Reg Atl24Uncertainty::LUA_META_TABLE[] = {
     {NULL,          NULL}
 };
 
-const char* Atl24Uncertainty::UNCERTAINTY_FILENAMES[NUM_DIMS][NUM_POINTING_ANGLES] = {
-   {"SNR_ATLAS_0_deg.csv",
-    "SNR_ATLAS_1_deg.csv",
-    "SNR_ATLAS_2_deg.csv",
-    "SNR_ATLAS_3_deg.csv",
-    "SNR_ATLAS_4_deg.csv",
-    "SNR_ATLAS_5_deg.csv"},
-   {"THU_ATLAS_0_deg.csv",
-    "THU_ATLAS_1_deg.csv",
-    "THU_ATLAS_2_deg.csv",
-    "THU_ATLAS_3_deg.csv",
-    "THU_ATLAS_4_deg.csv",
-    "THU_ATLAS_5_deg.csv"},
-   {"Transport_ATLAS_0_deg.csv",
-    "Transport_ATLAS_1_deg.csv",
-    "Transport_ATLAS_2_deg.csv",
-    "Transport_ATLAS_3_deg.csv",
-    "Transport_ATLAS_4_deg.csv",
-    "Transport_ATLAS_5_deg.csv"}
-};
+const char* Atl24Uncertainty::TABLE_IMAGE_NAME = "atl24_uncertainty.bin";
+const char* Atl24Uncertainty::TABLE_IMAGE_MAGIC = "ATL24LUT";
 
 // WIND_SPEED_INDEX[wind_speed] --> index
 const int Atl24Uncertainty::WIND_SPEED_INDEX[NUM_WIND_SPEEDS] = {
@@ -100,9 +84,13 @@ const int Atl24Uncertainty::KD_INDEX[NUM_KDS] = {
      4,  4,  4,  4,  4,  4,  4,  4,  4,  4  // 4
 };
 
-Atl24Uncertainty::entry_t Atl24Uncertainty::SNR[NUM_POINTING_ANGLES][NUM_TABLE_ENTRIES];
-Atl24Uncertainty::entry_t Atl24Uncertainty::THU[NUM_POINTING_ANGLES][NUM_TABLE_ENTRIES];
-Atl24Uncertainty::entry_t Atl24Uncertainty::TRANSPORT[NUM_POINTING_ANGLES][NUM_TABLE_ENTRIES];
+#include "Atl24UncertaintyTables.h" // EMBEDDED_SNR, EMBEDDED_THU, EMBEDDED_TRANSPORT
+
+Atl24Uncertainty::entry_t Atl24Uncertainty::imageTables[NUM_DIMS][NUM_POINTING_ANGLES][NUM_TABLE_ENTRIES];
+
+const Atl24Uncertainty::entry_t (*Atl24Uncertainty::SNR)[NUM_TABLE_ENTRIES] = EMBEDDED_SNR;
+const Atl24Uncertainty::entry_t (*Atl24Uncertainty::THU)[NUM_TABLE_ENTRIES] = EMBEDDED_THU;
+const Atl24Uncertainty::entry_t (*Atl24Uncertainty::TRANSPORT)[NUM_TABLE_ENTRIES] = EMBEDDED_TRANSPORT;
 
 /******************************************************************************
  * FUNCTIONS
@@ -137,7 +125,7 @@ static float elrad2deg(float rad)
  ******************************************************************************/
 
 /*----------------------------------------------------------------------------
- * luaCreate - create(<parms>)
+ * luaCreate - create(<parms>, [<fast path>])
  *----------------------------------------------------------------------------*/
 int Atl24Uncertainty::luaCreate (lua_State* L)
 {
@@ -146,7 +134,8 @@ int Atl24Uncertainty::luaCreate (lua_State* L)
     try
     {
         _parms = dynamic_cast<BathyParameters*>(getLuaObject(L, 1, BathyParameters::OBJECT_TYPE, BathyParameters::LUA_META_NAME));
-        return createLuaObject(L, new Atl24Uncertainty(L, _parms));
+        const bool _fast_path = getLuaBoolean(L, 2, true, DEFAULT_FAST_PATH);
+        return createLuaObject(L, new Atl24Uncertainty(L, _parms, _fast_path));
     }
     catch(const RunTimeException& e)
     {
@@ -158,104 +147,139 @@ int Atl24Uncertainty::luaCreate (lua_State* L)
 
 /*----------------------------------------------------------------------------
  * init
+ *
+ *  the tables are compiled in so nothing is read at startup unless a table
+ *  image has been installed; an image that fails validation is ignored
  *----------------------------------------------------------------------------*/
 void Atl24Uncertainty::init (void)
 {
-    /* for each dimension */
-    for(int dim = 0; dim < NUM_DIMS; dim++)
+    const FString image_filename("%s/%s", CONFDIR, TABLE_IMAGE_NAME);
+    if(access(image_filename.c_str(), F_OK) != 0)
     {
-        /* for each pointing angle */
-        for(int pointing_angle_index = 0; pointing_angle_index < NUM_POINTING_ANGLES; pointing_angle_index++)
-        {
-            /* get uncertainty filename */
-            const FString uncertainty_filename("%s/%s", CONFDIR, UNCERTAINTY_FILENAMES[dim][pointing_angle_index]);
-            print2term("Processing uncertainty file: %s\n", uncertainty_filename.c_str());
+        print2term("Using compiled in uncertainty tables\n");
+    }
+    else if(loadImage(image_filename.c_str()))
+    {
+        print2term("Using uncertainty tables from %s\n", image_filename.c_str());
+    }
+    else
+    {
+        print2term("Invalid uncertainty table image %s, using compiled in uncertainty tables\n", image_filename.c_str());
+    }
+}
 
-            /* open csv file */
-            fileptr_t file = fopen(uncertainty_filename.c_str(), "r");
-            if(!file)
-            {
-                char err_buf[256];
-                print2term("Failed to open file %s with error: %s\n", uncertainty_filename.c_str(), strerror_r(errno, err_buf, sizeof(err_buf))); // Get thread-safe error message
-                continue;
-            }
+/*----------------------------------------------------------------------------
+ * loadImage - replaces the compiled in tables with a binary table image
+ *
+ *  image layout (little endian), written by utils/gen_uncertainty_image.py:
+ *      char[8]     magic "ATL24LUT"
+ *      uint32      version, dimensions (3), pointing angles (6), entries (25)
+ *      entries     SNR, THU, Transport by pointing angle: int32 wind,
+ *                  char[16] Jerlov type, double a, b, c
+ *      uint64      FNV-1a hash of everything before it
+ *
+ *  the wind speed and Jerlov type of every entry must match the compiled in
+ *  tables since the lookup depends on their order; the tables in use are
+ *  only switched once the whole image has been validated, and must not be
+ *  switched while photons are being processed
+ *----------------------------------------------------------------------------*/
+bool Atl24Uncertainty::loadImage (const char* filename)
+{
+    const size_t header_size = 8 + (4 * sizeof(uint32_t));
+    const size_t entry_size = sizeof(int32_t) + sizeof(entry_t::JerlovType) + (3 * sizeof(double));
+    const size_t image_size = header_size + (NUM_DIMS * NUM_POINTING_ANGLES * NUM_TABLE_ENTRIES * entry_size) + sizeof(uint64_t);
 
-            /* read header line */
-            char header[40];
-            if(fscanf(file, "%39s\n", header) <= 0)
-            {
-                print2term("Failed to read header from uncertainty file %s\n", uncertainty_filename.c_str());
-                fclose(file);
-                continue;
-            }
+    /* read image */
+    fileptr_t file = fopen(filename, "rb");
+    if(!file)
+    {
+        char err_buf[256];
+        print2term("Failed to open file %s with error: %s\n", filename, strerror_r(errno, err_buf, sizeof(err_buf))); // Get thread-safe error message
+        return false;
+    }
+    vector<uint8_t> image(image_size + 1);
+    const size_t bytes_read = fread(image.data(), 1, image.size(), file);
+    fclose(file);
+    if(bytes_read != image_size)
+    {
+        print2term("Uncertainty table image %s is %ld bytes, expected %ld\n", filename, static_cast<long>(bytes_read), static_cast<long>(image_size));
+        return false;
+    }
 
-            /* read all rows */
-            if(dim == SNR_DIM)
-            {
-                /* SNR provides three coefficients: a, b, and c */
-                entry_t entry;
-                int row = 0;
-                while(fscanf(file, "%d,%15[^,],%lf,%lf,%lf\n", &entry.Wind, entry.JerlovType, &entry.a, &entry.b, &entry.c) == 5)
-                {
-                    if(row < NUM_TABLE_ENTRIES)
-                    {
-                        SNR[pointing_angle_index][row++] = entry;
-                    }
-                    else
-                    {
-                        print2term("Row %d in %s is ignored\n", row++, UNCERTAINTY_FILENAMES[SNR_DIM][pointing_angle_index]);
-                    }
-                }
-            }
-            else if(dim == THU_DIM)
-            {
-                /* THU provides two coefficients: a and b*/
-                entry_t entry;
-                entry.c = 0.0;
-                int row = 0;
-                while(fscanf(file, "%d,%15[^,],%lf,%lf\n", &entry.Wind, entry.JerlovType, &entry.a, &entry.b) == 4)
-                {
-                    if(row < NUM_TABLE_ENTRIES)
-                    {
-                        THU[pointing_angle_index][row++] = entry;
-                    }
-                    else
-                    {
-                        print2term("Row %d in %s is ignored\n", row++, UNCERTAINTY_FILENAMES[THU_DIM][pointing_angle_index]);
-                    }
-                }
-            }
-            else if(dim == TRANSPORT_DIM)
+    /* check hash */
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for(size_t i = 0; i < image_size - sizeof(uint64_t); i++)
+    {
+        hash ^= image[i];
+        hash *= 0x100000001B3ULL;
+    }
+    uint64_t expected_hash;
+    memcpy(&expected_hash, &image[image_size - sizeof(uint64_t)], sizeof(uint64_t));
+    if(hash != expected_hash)
+    {
+        print2term("Uncertainty table image %s is corrupt\n", filename);
+        return false;
+    }
+
+    /* check header */
+    uint32_t header[4];
+    memcpy(header, &image[8], sizeof(header));
+    if(memcmp(image.data(), TABLE_IMAGE_MAGIC, 8) != 0 || header[0] != TABLE_IMAGE_VERSION ||
+       header[1] != NUM_DIMS || header[2] != NUM_POINTING_ANGLES || header[3] != NUM_TABLE_ENTRIES)
+    {
+        print2term("Uncertainty table image %s has an unsupported format\n", filename);
+        return false;
+    }
+
+    /* parse and check entries */
+    const entry_t (*embedded[NUM_DIMS])[NUM_TABLE_ENTRIES] = {EMBEDDED_SNR, EMBEDDED_THU, EMBEDDED_TRANSPORT};
+    vector<entry_t> staged(NUM_DIMS * NUM_POINTING_ANGLES * NUM_TABLE_ENTRIES);
+    size_t offset = header_size;
+    for(int dim = 0; dim < NUM_DIMS; dim++)
+    {
+        for(int angle = 0; angle < NUM_POINTING_ANGLES; angle++)
+        {
+            for(int row = 0; row < NUM_TABLE_ENTRIES; row++)
             {
-                /* Transport provides two coefficients: a and b*/
-                entry_t entry;
-                entry.c = 0.0;
-                int row = 0;
-                while(fscanf(file, "%d,%15[^,],%lf,%lf\n", &entry.Wind, entry.JerlovType, &entry.a, &entry.b) == 4)
+                entry_t& entry = staged[(((dim * NUM_POINTING_ANGLES) + angle) * NUM_TABLE_ENTRIES) + row];
+                int32_t wind;
+                memcpy(&wind, &image[offset], sizeof(wind));
+                entry.Wind = wind;
+                memcpy(entry.JerlovType, &image[offset + sizeof(int32_t)], sizeof(entry.JerlovType));
+                memcpy(&entry.a, &image[offset + sizeof(int32_t) + sizeof(entry.JerlovType)], sizeof(double));
+                memcpy(&entry.b, &image[offset + sizeof(int32_t) + sizeof(entry.JerlovType) + sizeof(double)], sizeof(double));
+                memcpy(&entry.c, &image[offset + sizeof(int32_t) + sizeof(entry.JerlovType) + (2 * sizeof(double))], sizeof(double));
+                offset += entry_size;
+
+                const entry_t& expected = embedded[dim][angle][row];
+                if(entry.Wind != expected.Wind ||
+                   entry.JerlovType[sizeof(entry.JerlovType) - 1] != '\0' ||
+                   strcmp(entry.JerlovType, expected.JerlovType) != 0 ||
+                   !std::isfinite(entry.a) || !std::isfinite(entry.b) || !std::isfinite(entry.c))
                 {
-                    if(row < NUM_TABLE_ENTRIES)
-                    {
-                        TRANSPORT[pointing_angle_index][row++] = entry;
-                    }
-                    else
-                    {
-                        print2term("Row %d in %s is ignored\n", row++, UNCERTAINTY_FILENAMES[TRANSPORT_DIM][pointing_angle_index]);
-                    }
+                    print2term("Uncertainty table image %s has an invalid entry: dimension %d, pointing angle %d, row %d\n", filename, dim, angle, row);
+                    return false;
                 }
             }
-
-            /* close file */
-            fclose(file);
         }
     }
+
+    /* switch tables */
+    memcpy(imageTables, staged.data(), sizeof(imageTables));
+    SNR = imageTables[SNR_DIM];
+    THU = imageTables[THU_DIM];
+    TRANSPORT = imageTables[TRANSPORT_DIM];
+
+    return true;
 }
 
 /*----------------------------------------------------------------------------
  * Constructor
  *----------------------------------------------------------------------------*/
-Atl24Uncertainty::Atl24Uncertainty (lua_State* L, BathyParameters* _parms):
+Atl24Uncertainty::Atl24Uncertainty (lua_State* L, BathyParameters* _parms, bool _fast_path):
     GeoDataFrame::FrameRunner(L, LUA_META_NAME, LUA_META_TABLE),
-    parms(_parms)
+    parms(_parms),
+    fastPath(_fast_path)
 {
 }
 
@@ -290,30 +314,138 @@ bool Atl24Uncertainty::run (GeoDataFrame* dataframe)
     }
 
     /* create new columns */
-    FieldColumn<float>* sigma_thu = new FieldColumn<float>;
-    FieldColumn<float>* sigma_tvu = new FieldColumn<float>;
+    const long num_rows = dataframe->length();
+    FieldColumn<float>* sigma_thu = Atl24Columns::create<float>(num_rows);
+    FieldColumn<float>* sigma_tvu = Atl24Columns::create<float>(num_rows);
+
+    /* calculate uncertainties */
+    const inputs_t in = {surface_h, kd, surface_roughness, ref_el, geoid_corr_h, sigma_h, sigma_along, sigma_across};
+    const long num_fast = calculate(in, num_rows, fastPath, sigma_thu, sigma_tvu);
 
-    /* for each photon in extent */
-    for(long i = 0; i < dataframe->length(); i++)
+    mlog(DEBUG, "Uncertainty fast path taken by %ld of %ld photons", num_fast, num_rows);
+
+    /* add columns */
+    dataframe->addExistingColumn("sigma_thu", sigma_thu, "Total horizontal uncertainty (in meters)");
+    dataframe->addExistingColumn("sigma_tvu", sigma_tvu, "Total vertical uncertainty (in meters)");
+
+    /* mark completion */
+    return true;
+}
+
+/*----------------------------------------------------------------------------
+ * calculate - total uncertainties of num_rows photons appended to the output columns
+ *
+ *  shared by the frame runner and reprocessing of existing granules so both
+ *  produce identical results; returns the number of photons on the fast path
+ *----------------------------------------------------------------------------*/
+long Atl24Uncertainty::calculate (const inputs_t& in, long num_rows, bool fast_path, FieldColumn<float>* sigma_thu, FieldColumn<float>* sigma_tvu)
+{
+    /* batch working arrays */
+    batch_t batch;
+    long slot[BATCH_SIZE];
+    float batch_tvu[BATCH_SIZE];
+    float batch_thu[BATCH_SIZE];
+    float tvu[BATCH_SIZE];
+    float thu[BATCH_SIZE];
+    long num_fast = 0;
+
+    /* for each batch of photons in extent */
+    for(long start = 0; start < num_rows; start += BATCH_SIZE)
     {
-        /* get pointing angle index */
-        const int pointing_angle_index = discretize(elrad2deg((*ref_el)[i]), 0, NUM_POINTING_ANGLES);
-
-        /* get lookup table entry index */
-        const int wind_speed_lookup = discretize((*surface_roughness)[i], 0, NUM_WIND_SPEEDS);
-        const int kd_lookup = discretize((*kd)[i] * 100.0, 0, NUM_KDS, D_CEILING);
-        int entry_index = (WIND_SPEED_INDEX[wind_speed_lookup] * 5) + KD_INDEX[kd_lookup];
-        if(entry_index < 0 || entry_index >= NUM_TABLE_ENTRIES)
+        const long n = MIN(BATCH_SIZE, num_rows - start);
+
+        /* gather table coefficients and inputs into contiguous arrays */
+        long m = 0;
+        for(long k = 0, i = start; k < n; k++, i++)
         {
-            mlog(CRITICAL, "Invalid uncertainty table entry detected on row %ld: %d", i, entry_index);
-            entry_index = NUM_TABLE_ENTRIES - 1;
+            /* photons at or above the surface have no subaqueous terms */
+            const float depth = (*in.surface_h)[i] - (*in.geoid_corr_h)[i];
+            if(fast_path && !(depth > 0.0))
+            {
+                surface((*in.sigma_h)[i], (*in.sigma_along)[i], (*in.sigma_across)[i], tvu[k], thu[k]);
+                num_fast++;
+                continue;
+            }
+
+            /* get coefficients */
+            if(!lookup(batch, m, (*in.ref_el)[i], (*in.surface_roughness)[i], (*in.kd)[i]))
+            {
+                mlog(CRITICAL, "Invalid uncertainty table entry detected on row %ld", i);
+            }
+
+            /* get inputs */
+            batch.depth[m] = depth;
+            batch.sigma_h[m] = (*in.sigma_h)[i];
+            batch.sigma_along[m] = (*in.sigma_along)[i];
+            batch.sigma_across[m] = (*in.sigma_across)[i];
+            slot[m++] = k;
         }
 
-        /* get coefficients */
-        const entry_t& snr = SNR[pointing_angle_index][entry_index];
-        const entry_t& thu = THU[pointing_angle_index][entry_index];
-        const entry_t& transport = TRANSPORT[pointing_angle_index][entry_index];
+        /* calculate uncertainties */
+        kernel(batch, m, batch_tvu, batch_thu);
+        for(long j = 0; j < m; j++)
+        {
+            tvu[slot[j]] = batch_tvu[j];
+            thu[slot[j]] = batch_thu[j];
+        }
+
+        /* set uncertainties */
+        Atl24Columns::append(sigma_tvu, tvu, n);
+        Atl24Columns::append(sigma_thu, thu, n);
+    }
+
+    return num_fast;
+}
 
+/*----------------------------------------------------------------------------
+ * lookup - table coefficients for photon k of a batch
+ *
+ *  returns false if the photon falls outside the tables, in which case the
+ *  last table entry is used
+ *----------------------------------------------------------------------------*/
+bool Atl24Uncertainty::lookup (batch_t& batch, long k, float ref_el, float surface_roughness, float kd)
+{
+    bool status = true;
+
+    /* get pointing angle index */
+    const int pointing_angle_index = discretize(elrad2deg(ref_el), 0, NUM_POINTING_ANGLES);
+
+    /* get lookup table entry index */
+    const int wind_speed_lookup = discretize(surface_roughness, 0, NUM_WIND_SPEEDS);
+    const int kd_lookup = discretize(kd * 100.0, 0, NUM_KDS, D_CEILING);
+    int entry_index = (WIND_SPEED_INDEX[wind_speed_lookup] * 5) + KD_INDEX[kd_lookup];
+    if(entry_index < 0 || entry_index >= NUM_TABLE_ENTRIES)
+    {
+        entry_index = NUM_TABLE_ENTRIES - 1;
+        status = false;
+    }
+
+    /* get coefficients */
+    const entry_t& snr = SNR[pointing_angle_index][entry_index];
+    const entry_t& thu_entry = THU[pointing_angle_index][entry_index];
+    const entry_t& transport = TRANSPORT[pointing_angle_index][entry_index];
+    batch.snr_a[k] = snr.a;
+    batch.snr_b[k] = snr.b;
+    batch.snr_c[k] = snr.c;
+    batch.thu_a[k] = thu_entry.a;
+    batch.thu_b[k] = thu_entry.b;
+    batch.transport_a[k] = transport.a;
+    batch.transport_b[k] = transport.b;
+
+    return status;
+}
+
+/*----------------------------------------------------------------------------
+ * kernel - total uncertainties for a batch of photons
+ *
+ *  branch free over contiguous arrays so that the compiler can vectorize it;
+ *  arithmetic is kept in double precision and in the same order as the
+ *  per-photon formulation so results are bit-for-bit identical
+ *----------------------------------------------------------------------------*/
+void Atl24Uncertainty::kernel (const batch_t& batch, long n, float* __restrict tvu, float* __restrict thu)
+{
+    for(long k = 0; k < n; k++)
+    {
         /**********************************************************************
             - Email from Keana Keif -
             - Dated August 17, 2026 -
@@ -343,38 +475,46 @@ bool Atl24Uncertainty::run (GeoDataFrame* dataframe)
          23      sigma_thu = sqrt (sigma_along ^2  + sigma_across^2 + sub_thu^2)
         **********************************************************************/
 
-        /* calculate subaqueous uncertainty */
-        double transport_uncertainty = 0.0;
-        double signal_uncertainty = 0.0;
-        double subaqueous_horizontal_uncertainty = 0.0;
-        const double depth = (*surface_h)[i] - (*geoid_corr_h)[i];
-        if(depth > 0.0)
-        {
-            /* transport uncertainty */
-            transport_uncertainty = sqrt(pow(transport.a, 2) + pow(transport.b * depth, 2)); // [11]
+        /* calculate subaqueous uncertainty (only applies to photons below the surface) */
+        const double depth = batch.depth[k];
+        const bool subaqueous = depth > 0.0;
 
-            /* signal uncertainty */
-            double signal_to_noise = (snr.a * pow(depth, 2)) + (snr.b * depth) + snr.c; // [14]
-            if(signal_to_noise < 1) signal_to_noise = 1; // [15]
-            signal_uncertainty = 0.071 / sqrt(2 * signal_to_noise); // [16]
+        /* transport uncertainty */
+        const double transport_b_depth = batch.transport_b[k] * depth;
+        const double transport_uncertainty = subaqueous ? sqrt((batch.transport_a[k] * batch.transport_a[k]) + (transport_b_depth * transport_b_depth)) : 0.0; // [11]
 
-            /* subaqueous horizontal uncertainty */
-            subaqueous_horizontal_uncertainty = 0.577 * (thu.a + (thu.b * depth)); // [22]
-        }
+        /* signal uncertainty */
+        double signal_to_noise = (batch.snr_a[k] * (depth * depth)) + (batch.snr_b[k] * depth) + batch.snr_c[k]; // [14]
+        signal_to_noise = signal_to_noise < 1 ? 1 : signal_to_noise; // [15]
+        const double signal_uncertainty = subaqueous ? 0.071 / sqrt(2 * signal_to_noise) : 0.0; // [16]
 
-        /* total uncertainties */
-        const double total_vertical_uncertainty = sqrt(pow((*sigma_h)[i], 2) + pow(transport_uncertainty, 2) + pow(signal_uncertainty, 2)); // [19]
-        const double total_horizontal_uncertainty = sqrt(pow((*sigma_across)[i], 2) + pow((*sigma_along)[i], 2) + pow(subaqueous_horizontal_uncertainty, 2));
+        /* subaqueous horizontal uncertainty */
+        const double subaqueous_horizontal_uncertainty = subaqueous ? 0.577 * (batch.thu_a[k] + (batch.thu_b[k] * depth)) : 0.0; // [22]
 
-        /* set uncertainties */
-        sigma_tvu->append(static_cast<float>(total_vertical_uncertainty));
-        sigma_thu->append(static_cast<float>(total_horizontal_uncertainty));
+        /* total uncertainties */
+        const double sigma_h = batch.sigma_h[k];
+        const double sigma_across = batch.sigma_across[k];
+        const double sigma_along = batch.sigma_along[k];
+        const double total_vertical_uncertainty = sqrt((sigma_h * sigma_h) + (transport_uncertainty * transport_uncertainty) + (signal_uncertainty * signal_uncertainty)); // [19]
+        const double total_horizontal_uncertainty = sqrt((sigma_across * sigma_across) + (sigma_along * sigma_along) + (subaqueous_horizontal_uncertainty * subaqueous_horizontal_uncertainty));
+
+        tvu[k] = static_cast<float>(total_vertical_uncertainty);
+        thu[k] = static_cast<float>(total_horizontal_uncertainty);
     }
+}
 
-    /* add columns */
-    dataframe->addExistingColumn("sigma_thu", sigma_thu, "Total horizontal uncertainty (in meters)");
-    dataframe->addExistingColumn("sigma_tvu", sigma_tvu, "Total vertical uncertainty (in meters)");
-
-    /* mark completion */
-    return true;
+/*----------------------------------------------------------------------------
+ * surface - total uncertainties for a photon at or above the surface
+ *
+ *  same result as the kernel when depth is not positive, where the transport,
+ *  signal and subaqueous horizontal terms are all zero and the table lookup
+ *  is not needed
+ *----------------------------------------------------------------------------*/
+void Atl24Uncertainty::surface (float sigma_h, float sigma_along, float sigma_across, float& tvu, float& thu)
+{
+    const double h = sigma_h;
+    const double across = sigma_across;
+    const double along = sigma_along;
+    tvu = static_cast<float>(sqrt((h * h) + 0.0 + 0.0)); // [19]
+    thu = static_cast<float>(sqrt((across * across) + (along * along) + 0.0));
 }
@@ -54,12 +54,53 @@ class Atl24Uncertainty: public GeoDataFrame::FrameRunner
         static const char* LUA_META_NAME;
         static const struct luaL_Reg LUA_META_TABLE[];
 
+        static const long BATCH_SIZE = 1024;
+        static const bool DEFAULT_FAST_PATH = true; // skip table lookup for photons at or above the surface
+
+        static const char* TABLE_IMAGE_NAME; // optional binary image in CONFDIR that replaces the compiled in tables
+        static const char* TABLE_IMAGE_MAGIC;
+        static const uint32_t TABLE_IMAGE_VERSION = 1;
+
+        /*--------------------------------------------------------------------
+         * Typedefs
+         *--------------------------------------------------------------------*/
+
+        typedef struct {
+            double snr_a[BATCH_SIZE];
+            double snr_b[BATCH_SIZE];
+            double snr_c[BATCH_SIZE];
+            double thu_a[BATCH_SIZE];
+            double thu_b[BATCH_SIZE];
+            double transport_a[BATCH_SIZE];
+            double transport_b[BATCH_SIZE];
+            float  depth[BATCH_SIZE];
+            float  sigma_h[BATCH_SIZE];
+            float  sigma_along[BATCH_SIZE];
+            float  sigma_across[BATCH_SIZE];
+        } batch_t;
+
+        typedef struct {
+            FieldColumn<float>* surface_h;
+            FieldColumn<float>* kd;
+            FieldColumn<float>* surface_roughness;
+            FieldColumn<float>* ref_el;
+            FieldColumn<float>* geoid_corr_h;
+            FieldColumn<float>* sigma_h;
+            FieldColumn<float>* sigma_along;
+            FieldColumn<float>* sigma_across;
+        } inputs_t;
+
         /*--------------------------------------------------------------------
          * Methods
          *--------------------------------------------------------------------*/
 
         static int      luaCreate   (lua_State* L);
         static void     init        (void);
+        static bool     loadImage   (const char* filename);
+        static bool     lookup      (batch_t& batch, long k, float ref_el, float surface_roughness, float kd);
+        static void     kernel      (const batch_t& batch, long n, float* __restrict tvu, float* __restrict thu);
+        static void     surface     (float sigma_h, float sigma_along, float sigma_across, float& tvu, float& thu);
+        static long     calculate   (const inputs_t& in, long num_rows, bool fast_path, FieldColumn<float>* sigma_thu, FieldColumn<float>* sigma_tvu);
         bool            run         (GeoDataFrame* dataframe) override;
 
     private:
@@ -87,7 +128,7 @@ class Atl24Uncertainty: public GeoDataFrame::FrameRunner
          * Methods
          *--------------------------------------------------------------------*/
 
-        Atl24Uncertainty  (lua_State* L, BathyParameters* _parms);
+        Atl24Uncertainty  (lua_State* L, BathyParameters* _parms, bool _fast_path);
         ~Atl24Uncertainty (void) override;
 
         /*--------------------------------------------------------------------
@@ -101,14 +142,18 @@ class Atl24Uncertainty: public GeoDataFrame::FrameRunner
         static const int            WIND_SPEED_INDEX[NUM_WIND_SPEEDS];
         static const int            KD_INDEX[NUM_KDS];
 
-        static const char*          UNCERTAINTY_FILENAMES[NUM_DIMS][NUM_POINTING_ANGLES];
-
         static const int            NUM_TABLE_ENTRIES = 25;
-        static entry_t              SNR[NUM_POINTING_ANGLES][NUM_TABLE_ENTRIES];
-        static entry_t              THU[NUM_POINTING_ANGLES][NUM_TABLE_ENTRIES];
-        static entry_t              TRANSPORT[NUM_POINTING_ANGLES][NUM_TABLE_ENTRIES];
+        static const entry_t        EMBEDDED_SNR[NUM_POINTING_ANGLES][NUM_TABLE_ENTRIES]; // generated from tables/*.csv at build time
+        static const entry_t        EMBEDDED_THU[NUM_POINTING_ANGLES][NUM_TABLE_ENTRIES];
+        static const entry_t        EMBEDDED_TRANSPORT[NUM_POINTING_ANGLES][NUM_TABLE_ENTRIES];
+        static entry_t              imageTables[NUM_DIMS][NUM_POINTING_ANGLES][NUM_TABLE_ENTRIES];
+
+        static const entry_t        (*SNR)[NUM_TABLE_ENTRIES]; // tables used by lookup, compiled in unless replaced by an image
+        static const entry_t        (*THU)[NUM_TABLE_ENTRIES];
+        static const entry_t        (*TRANSPORT)[NUM_TABLE_ENTRIES];
 
         BathyParameters*            parms;
+        bool                        fastPath;
 };
 
 #endif
\ No newline at end of file
@@ -34,9 +34,11 @@
  ******************************************************************************/
 
 #include <uuid/uuid.h>
+#include <set>
 
 #include "Atl24Writer.h"
 #include "PluginFields.h"
+#include "Atl24Columns.h"
 #include "OsApi.h"
 #include "EventLib.h"
 #include "List.h"
@@ -75,13 +77,37 @@ static void add_group(List<HdfLib::dataset_t>& datasets, const char* name)
     datasets.add(group);
 }
 
-static void add_variable(List<HdfLib::dataset_t>& datasets, const char* name, const Field* field)
+static void add_variable(List<HdfLib::dataset_t>& datasets, const char* name, Field* field, bool release=false)
 {
     long size = field->length() * field->getTypeSize();
     uint8_t* buffer = new uint8_t[size];
     field->serialize(buffer, size);
     HdfLib::dataset_t variable = {name, HdfLib::VARIABLE, static_cast<RecordObject::fieldType_t>(field->getEncodedType()), buffer, size};
     datasets.add(variable);
+    if(release) field->clear(); // staged copy is now the only copy
+}
+
+template<class T>
+static void add_column(List<HdfLib::dataset_t>& datasets, std::set<const uint8_t*>& borrowed, const char* name, FieldColumn<T>* column, bool release)
+{
+    // borrow the column's storage when it was created by Atl24Columns and
+    // still fits in the single chunk it was sized with; otherwise stage a copy
+    // (this includes every BathyDataFrame input column - their FieldColumn
+    // storage is chunked by the upstream dataframe and offers no accessor
+    // that says whether it is one allocation)
+    const long num_elements = column->length();
+    T* storage = Atl24Columns::contiguous(column);
+    if(storage && column->getTypeSize() == sizeof(T))
+    {
+        uint8_t* buffer = reinterpret_cast<uint8_t*>(storage);
+        HdfLib::dataset_t variable = {name, HdfLib::VARIABLE, static_cast<RecordObject::fieldType_t>(column->getEncodedType()), buffer, static_cast<long>(num_elements * sizeof(T))};
+        datasets.add(variable);
+        borrowed.insert(buffer);
+    }
+    else
+    {
+        add_variable(datasets, name, column, release);
+    }
 }
 
 static void add_scalar(List<HdfLib::dataset_t>& datasets, const char* name, const Field* field)
@@ -140,7 +166,9 @@ void Atl24Writer::init (void)
 }
 
 /*----------------------------------------------------------------------------
- * luaCreate - create(<table of beams>)
+ * luaCreate - create(<parms>, <table of beams>, <granule>, <release>, [<streaming>], [<compression>])
+ *
+ *  compression: {chunk_size=<elements>, shuffle=<bool>, deflate=<1-9>, zstd=<1-22>}
  *----------------------------------------------------------------------------*/
 int Atl24Writer::luaCreate (lua_State* L)
 {
@@ -154,6 +182,8 @@ int Atl24Writer::luaCreate (lua_State* L)
         int dataframe_table_index = 2;
         int granule_index = 3;
         int release_index = 4;
+        int streaming_index = 5;
+        int compression_index = 6;
 
         /* Get Parameters */
         _parms = dynamic_cast<Icesat2Parameters*>(getLuaObject(L, parms_index, Icesat2Parameters::OBJECT_TYPE));
@@ -178,8 +208,15 @@ int Atl24Writer::luaCreate (lua_State* L)
         /* Get Release Number */
         const char* _release = getLuaString(L, release_index);
 
+        /* Get Streaming Mode */
+        const bool _streaming = getLuaBoolean(L, streaming_index, true, false);
+
+        /* Get Compression Options */
+        Atl24Compression::parms_t _compression;
+        Atl24Compression::fromLua(L, compression_index, _compression);
+
         /* Return Dispatch Object */
-        return createLuaObject(L, new Atl24Writer(L, _parms, _dataframes, _granule, _release));
+        return createLuaObject(L, new Atl24Writer(L, _parms, _dataframes, _granule, _release, _streaming, _compression));
     }
     catch(const RunTimeException& e)
     {
@@ -197,11 +234,13 @@ int Atl24Writer::luaCreate (lua_State* L)
 /*----------------------------------------------------------------------------
  * Constructor
  *----------------------------------------------------------------------------*/
-Atl24Writer::Atl24Writer(lua_State* L, Icesat2Parameters* _parms, BathyDataFrame** _dataframes, Atl03Granule* _granule, const char* _release):
+Atl24Writer::Atl24Writer(lua_State* L, Icesat2Parameters* _parms, BathyDataFrame** _dataframes, Atl03Granule* _granule, const char* _release, bool _streaming, const Atl24Compression::parms_t& _compression):
     LuaObject(L, OBJECT_TYPE, LUA_META_NAME, LUA_META_TABLE),
     release(FString("0%s", _release).c_str()),
     parms(_parms),
-    granule(_granule)
+    granule(_granule),
+    streaming(_streaming),
+    compression(_compression)
 {
     for(int i = 0; i < NUM_BEAMS; i++)
     {
@@ -233,6 +272,240 @@ Atl24Writer::~Atl24Writer(void)
     }
 }
 
+/*----------------------------------------------------------------------------
+ * prepareBeam - builds the datasets of one beam group (runs in its own thread)
+ *----------------------------------------------------------------------------*/
+void* Atl24Writer::prepareBeam (void* parm)
+{
+    beam_work_t* work = static_cast<beam_work_t*>(parm);
+    BathyDataFrame* df = work->df;
+    const bool release = work->release;
+
+    try
+    {
+        /* Create Beam Group */
+        add_group(work->datasets, work->beam);
+
+        /* Create Variable - class_ph */
+        FieldColumn<int8_t>* class_ph = reinterpret_cast<FieldColumn<int8_t>*>(df->getColumn("class_ph"));
+        add_column(work->datasets, work->borrowed, "class_ph", class_ph, release);
+        add_attribute(work->datasets, "contentType", "modelResults");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "0 - unclassified, 1 - other, 40 - bathymetry, 41 - sea surface");
+        add_attribute(work->datasets, "long_name", "Photon classification");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "scalar");
+        goto_parent(work->datasets);
+
+        /* Create Variable - confidence */
+        FieldColumn<float>* confidence = reinterpret_cast<FieldColumn<float>*>(df->getColumn("confidence"));
+        add_column(work->datasets, work->borrowed, "confidence", confidence, release);
+        add_attribute(work->datasets, "contentType", "modelResult");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "ensemble confidence score from 0.0 to 1.0 where larger numbers represent higher confidence in classification");
+        add_attribute(work->datasets, "long_name", "Ensemble confidence");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "scalar");
+        goto_parent(work->datasets);
+
+        /* Create Variable - delta_time */
+        FieldColumn<double> delta_time(0, Atl24Columns::chunkSize(df->time_ns.length()));
+        for(long j = 0; j < df->time_ns.length(); j++)
+        {
+            static const double ATLAS_LEAP_SECONDS = 18; // optimization based on the time period of ATLAS data at the time of ATL24 generation (2025)
+            double value = (df->time_ns[j].nanoseconds / 1000000000.0) - (Icesat2Parameters::ATLAS_SDP_EPOCH_GPS + TimeLib::GPS_EPOCH_START - ATLAS_LEAP_SECONDS);
+            delta_time.append(value);
+        }
+        if(release) df->time_ns.clear();
+        add_variable(work->datasets, "delta_time", &delta_time);
+        add_attribute(work->datasets, "contentType", "physicalMeasurement");
+        add_attribute(work->datasets, "coordinates", "lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "The transmit time of a given photon, measured in seconds from the ATLAS Standard Data Product Epoch. Note that multiple received photons associated with a single transmit pulse will have the same delta_time. The ATLAS Standard Data Products (SDP) epoch offset is defined within /ancillary_data/atlas_sdp_gps_epoch as the number of GPS seconds between the GPS epoch (1980-01-06T00:00:00.000000Z UTC) and the ATLAS SDP epoch. By adding the offset contained within atlas_sdp_gps_epoch to delta time parameters, the time in gps_seconds relative to the GPS epoch can be computed.");
+        add_attribute(work->datasets, "long_name", "Elapsed GPS seconds");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "seconds since 2018-01-01");
+        goto_parent(work->datasets);
+
+        /* Create Variable - ellipse_h */
+        add_column(work->datasets, work->borrowed, "ellipse_h", &df->ellipse_h, release);
+        add_attribute(work->datasets, "contentType", "physicalMeasurement");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "Height of each received photon, relative to the WGS-84 ellipsoid including refraction correction. Note neither the geoid, ocean tide nor the dynamic atmosphere (DAC) corrections are applied to the ellipsoidal heights.");
+        add_attribute(work->datasets, "long_name", "Photon WGS84 height");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "meters");
+        goto_parent(work->datasets);
+
+        /* Create Variable - index_ph */
+        add_column(work->datasets, work->borrowed, "index_ph", &df->index_ph, release);
+        add_attribute(work->datasets, "contentType", "physicalMeasurement");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "0-based index of the photon in the ATL03 heights group");
+        add_attribute(work->datasets, "long_name", "Photon index");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "scalar");
+        goto_parent(work->datasets);
+
+        /* Create Variable - index_seg */
+        add_column(work->datasets, work->borrowed, "index_seg", &df->index_seg, release);
+        add_attribute(work->datasets, "contentType", "physicalMeasurement");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "0-based index of the photon in the ATL03 geolocation group");
+        add_attribute(work->datasets, "long_name", "Segment index");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "scalar");
+        goto_parent(work->datasets);
+
+        /* Create Variable - index_seg */
+        add_column(work->datasets, work->borrowed, "segment_id", &df->segment_id, release);
+        add_attribute(work->datasets, "contentType", "physicalMeasurement");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "ATL03 segment id of the photon");
+        add_attribute(work->datasets, "long_name", "Segment ID");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "scalar");
+        goto_parent(work->datasets);
+
+        /* Create Variable - lat_ph */
+        add_column(work->datasets, work->borrowed, "lat_ph", &df->lat_ph, release);
+        add_attribute(work->datasets, "contentType", "modelResult");
+        add_attribute(work->datasets, "coordinates", "delta_time lon_ph");
+        add_attribute(work->datasets, "description", "Latitude of each received photon. Computed from the ECF Cartesian coordinates of the bounce point.");
+        add_attribute(work->datasets, "long_name", "Latitude");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "degrees_north");
+        add_attribute(work->datasets, "standard_name", "latitude");
+        add_attribute_double(work->datasets, "valid_max", 90.0);
+        add_attribute_double(work->datasets, "valid_min", -90.0);
+        goto_parent(work->datasets);
+
+        /* Create Variable - lon_ph */
+        add_column(work->datasets, work->borrowed, "lon_ph", &df->lon_ph, release);
+        add_attribute(work->datasets, "contentType", "modelResult");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph");
+        add_attribute(work->datasets, "description", "Longitude of each received photon. Computed from the ECF Cartesian coordinates of the bounce point.");
+        add_attribute(work->datasets, "long_name", "Longitude");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "degrees_east");
+        add_attribute(work->datasets, "standard_name", "longitude");
+        add_attribute_double(work->datasets, "valid_max", 180.0);
+        add_attribute_double(work->datasets, "valid_min", -180.0);
+        goto_parent(work->datasets);
+
+        /* Create Variable - night_flag */
+        FieldColumn<int8_t> night_flag(0, Atl24Columns::chunkSize(df->processing_flags.length()));
+        for(long i = 0; i < df->processing_flags.length(); i++)
+        {
+            night_flag.append(static_cast<int8_t>((df->processing_flags[i] & BathyParameters::NIGHT_FLAG) != 0));
+        }
+        if(release) df->processing_flags.clear();
+        add_variable(work->datasets, "night_flag", &night_flag);
+        add_attribute(work->datasets, "contentType", "modelResult");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "The solar elevation was less than 5 degrees at the time and location of the photon");
+        add_attribute(work->datasets, "long_name", "Night flag");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "boolean");
+        add_attribute(work->datasets, "flag_meanings", "false, true");
+        add_attribute(work->datasets, "flag_values", "0, 1");
+        goto_parent(work->datasets);
+
+        /* Create Variable - ortho_h */
+        add_column(work->datasets, work->borrowed, "ortho_h", &df->geoid_corr_h, release);
+        add_attribute(work->datasets, "contentType", "physicalMeasurement");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "Height of each received photon, relative to the geoid.");
+        add_attribute(work->datasets, "long_name", "Orthometric height");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "meters");
+        goto_parent(work->datasets);
+
+        /* Create Variable - sigma_thu */
+        FieldColumn<float>* sigma_thu = reinterpret_cast<FieldColumn<float>*>(df->getColumn("sigma_thu"));
+        add_column(work->datasets, work->borrowed, "sigma_thu", sigma_thu, release);
+        add_attribute(work->datasets, "contentType", "physicalMeasurement");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "The combination of the aerial and subaqueous horizontal uncertainty for each received photon");
+        add_attribute(work->datasets, "long_name", "Total horizontal uncertainty");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "meters");
+        goto_parent(work->datasets);
+
+        /* Create Variable - sigma_tvu */
+        FieldColumn<float>* sigma_tvu = reinterpret_cast<FieldColumn<float>*>(df->getColumn("sigma_tvu"));
+        add_column(work->datasets, work->borrowed, "sigma_tvu", sigma_tvu, release);
+        add_attribute(work->datasets, "contentType", "modelResult");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "The combination of the aerial and subaqueous vertical uncertainty for each received photon");
+        add_attribute(work->datasets, "long_name", "Total vertical uncertainty");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "meters");
+        goto_parent(work->datasets);
+
+        /* Create Variable - surface_h */
+        FieldColumn<float>* surface_h = reinterpret_cast<FieldColumn<float>*>(df->getColumn("surface_h"));
+        add_column(work->datasets, work->borrowed, "surface_h", surface_h, release);
+        add_attribute(work->datasets, "contentType", "modelResult");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "The geoid corrected height of the sea surface at the detected photon");
+        add_attribute(work->datasets, "long_name", "Sea surface orthometric height");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "meters");
+        goto_parent(work->datasets);
+
+        /* Create Variable - x_atc */
+        add_column(work->datasets, work->borrowed, "x_atc", &df->x_atc, release);
+        add_attribute(work->datasets, "contentType", "modelResult");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "Along-track distance in a segment projected to the ellipsoid of the received photon, based on the Along-Track Segment algorithm.  Total along track distance can be found by adding this value to the sum of segment lengths measured from the start of the most recent reference groundtrack.");
+        add_attribute(work->datasets, "long_name", "Distance from equator crossing");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "meters");
+        goto_parent(work->datasets);
+
+        /* Create Variable - y_atc */
+        add_column(work->datasets, work->borrowed, "y_atc", &df->y_atc, release);
+        add_attribute(work->datasets, "contentType", "modelResult");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "Across-track distance projected to the ellipsoid of the received photon from the reference ground track.  This is based on the Along-Track Segment algorithm described in Section 3.1 of the ATBD.");
+        add_attribute(work->datasets, "long_name", "Distance off RGT");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "meters");
+        goto_parent(work->datasets);
+
+        /* Create Variable - kd */
+        FieldColumn<float>* kd = reinterpret_cast<FieldColumn<float>*>(df->getColumn("kd"));
+        add_column(work->datasets, work->borrowed, "kd", kd, release);
+        add_attribute(work->datasets, "contentType", "modelResult");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "Turbidity of water column calculated using only ICESat-2 photons");
+        add_attribute(work->datasets, "long_name", "Turbidity");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "meters");
+        goto_parent(work->datasets);
+
+        /* Create Variable - surface_roughness */
+        FieldColumn<float>* surface_roughness = reinterpret_cast<FieldColumn<float>*>(df->getColumn("surface_roughness"));
+        add_column(work->datasets, work->borrowed, "surface_roughness", surface_roughness, release);
+        add_attribute(work->datasets, "contentType", "modelResult");
+        add_attribute(work->datasets, "coordinates", "delta_time lat_ph lon_ph");
+        add_attribute(work->datasets, "description", "Measure of wave heights and proxy for wind speed in uncertainty calculation");
+        add_attribute(work->datasets, "long_name", "Surface Roughness");
+        add_attribute(work->datasets, "source", "ATL03");
+        add_attribute(work->datasets, "units", "meters");
+        goto_parent(work->datasets);
+
+        /* Go Back to Parent Group */
+        goto_parent(work->datasets);
+    }
+    catch(const std::exception& e) // includes bad_alloc, which must not escape the thread
+    {
+        work->error = FString("%s: %s", work->beam, e.what()).c_str();
+    }
+
+    return NULL;
+}
+
 /*----------------------------------------------------------------------------
  * writeFile
  *----------------------------------------------------------------------------*/
@@ -240,6 +513,9 @@ int Atl24Writer::luaWriteFile(lua_State* L)
 {
     bool status;
     List<HdfLib::dataset_t> datasets;
+    std::set<const uint8_t*> borrowed; // dataset buffers owned by the dataframes
+    beam_work_t beams[NUM_BEAMS];
+    Thread* threads[NUM_BEAMS] = {NULL, NULL, NULL, NULL, NULL, NULL};
 
     try
     {
@@ -260,6 +536,7 @@ int Atl24Writer::luaWriteFile(lua_State* L)
         /* Create Beam Groups */
         /**********************/
         BathyDataFrame* last_df = NULL;
+        string beam_error;
         for(int i = 0; i < NUM_BEAMS; i++)
         {
             /* Get and Check DataFrame for Beam */
@@ -267,219 +544,27 @@ int Atl24Writer::luaWriteFile(lua_State* L)
             if(!df || df->time_ns.length() <= 0) continue;
             last_df = df;
 
-            /* Create Beam Group */
-            add_group(datasets, BEAMS[i]);
-
-            /* Create Variable - class_ph */
-            FieldColumn<int8_t>* class_ph = reinterpret_cast<FieldColumn<int8_t>*>(df->getColumn("class_ph"));
-            add_variable(datasets, "class_ph", class_ph);
-            add_attribute(datasets, "contentType", "modelResults");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "0 - unclassified, 1 - other, 40 - bathymetry, 41 - sea surface");
-            add_attribute(datasets, "long_name", "Photon classification");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "scalar");
-            goto_parent(datasets);
-
-            /* Create Variable - confidence */
-            FieldColumn<float>* confidence = reinterpret_cast<FieldColumn<float>*>(df->getColumn("confidence"));
-            add_variable(datasets, "confidence", confidence);
-            add_attribute(datasets, "contentType", "modelResult");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "ensemble confidence score from 0.0 to 1.0 where larger numbers represent higher confidence in classification");
-            add_attribute(datasets, "long_name", "Ensemble confidence");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "scalar");
-            goto_parent(datasets);
-
-            /* Create Variable - delta_time */
-            FieldColumn<double> delta_time;
-            for(long j = 0; j < df->time_ns.length(); j++)
-            {
-                static const double ATLAS_LEAP_SECONDS = 18; // optimization based on the time period of ATLAS data at the time of ATL24 generation (2025)
-                double value = (df->time_ns[j].nanoseconds / 1000000000.0) - (Icesat2Parameters::ATLAS_SDP_EPOCH_GPS + TimeLib::GPS_EPOCH_START - ATLAS_LEAP_SECONDS);
-                delta_time.append(value);
-            }
-            add_variable(datasets, "delta_time", &delta_time);
-            add_attribute(datasets, "contentType", "physicalMeasurement");
-            add_attribute(datasets, "coordinates", "lat_ph lon_ph");
-            add_attribute(datasets, "description", "The transmit time of a given photon, measured in seconds from the ATLAS Standard Data Product Epoch. Note that multiple received photons associated with a single transmit pulse will have the same delta_time. The ATLAS Standard Data Products (SDP) epoch offset is defined within /ancillary_data/atlas_sdp_gps_epoch as the number of GPS seconds between the GPS epoch (1980-01-06T00:00:00.000000Z UTC) and the ATLAS SDP epoch. By adding the offset contained within atlas_sdp_gps_epoch to delta time parameters, the time in gps_seconds relative to the GPS epoch can be computed.");
-            add_attribute(datasets, "long_name", "Elapsed GPS seconds");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "seconds since 2018-01-01");
-            goto_parent(datasets);
-
-            /* Create Variable - ellipse_h */
-            add_variable(datasets, "ellipse_h", &df->ellipse_h);
-            add_attribute(datasets, "contentType", "physicalMeasurement");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "Height of each received photon, relative to the WGS-84 ellipsoid including refraction correction. Note neither the geoid, ocean tide nor the dynamic atmosphere (DAC) corrections are applied to the ellipsoidal heights.");
-            add_attribute(datasets, "long_name", "Photon WGS84 height");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "meters");
-            goto_parent(datasets);
-
-            /* Create Variable - index_ph */
-            add_variable(datasets, "index_ph", &df->index_ph);
-            add_attribute(datasets, "contentType", "physicalMeasurement");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "0-based index of the photon in the ATL03 heights group");
-            add_attribute(datasets, "long_name", "Photon index");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "scalar");
-            goto_parent(datasets);
-
-            /* Create Variable - index_seg */
-            add_variable(datasets, "index_seg", &df->index_seg);
-            add_attribute(datasets, "contentType", "physicalMeasurement");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "0-based index of the photon in the ATL03 geolocation group");
-            add_attribute(datasets, "long_name", "Segment index");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "scalar");
-            goto_parent(datasets);
-
-            /* Create Variable - index_seg */
-            add_variable(datasets, "segment_id", &df->segment_id);
-            add_attribute(datasets, "contentType", "physicalMeasurement");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "ATL03 segment id of the photon");
-            add_attribute(datasets, "long_name", "Segment ID");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "scalar");
-            goto_parent(datasets);
-
-            /* Create Variable - lat_ph */
-            add_variable(datasets, "lat_ph", &df->lat_ph);
-            add_attribute(datasets, "contentType", "modelResult");
-            add_attribute(datasets, "coordinates", "delta_time lon_ph");
-            add_attribute(datasets, "description", "Latitude of each received photon. Computed from the ECF Cartesian coordinates of the bounce point.");
-            add_attribute(datasets, "long_name", "Latitude");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "degrees_north");
-            add_attribute(datasets, "standard_name", "latitude");
-            add_attribute_double(datasets, "valid_max", 90.0);
-            add_attribute_double(datasets, "valid_min", -90.0);
-            goto_parent(datasets);
-
-            /* Create Variable - lon_ph */
-            add_variable(datasets, "lon_ph", &df->lon_ph);
-            add_attribute(datasets, "contentType", "modelResult");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph");
-            add_attribute(datasets, "description", "Longitude of each received photon. Computed from the ECF Cartesian coordinates of the bounce point.");
-            add_attribute(datasets, "long_name", "Longitude");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "degrees_east");
-            add_attribute(datasets, "standard_name", "longitude");
-            add_attribute_double(datasets, "valid_max", 180.0);
-            add_attribute_double(datasets, "valid_min", -180.0);
-            goto_parent(datasets);
+            /* Prepare Beam Group (release dataframe columns as they are staged in streaming mode, borrowed columns are kept) */
+            beams[i].df = df;
+            beams[i].beam = BEAMS[i];
+            beams[i].release = lua_obj->streaming;
+            threads[i] = new Thread(prepareBeam, &beams[i]);
+        }
 
-            /* Create Variable - night_flag */
-            FieldColumn<int8_t> night_flag;
-            for(long i = 0; i < df->processing_flags.length(); i++)
+        /* Wait for Beam Groups and Emit in Beam Order */
+        for(int i = 0; i < NUM_BEAMS; i++)
+        {
+            if(!threads[i]) continue;
+            delete threads[i]; // joins
+            threads[i] = NULL;
+            for(int j = 0; j < beams[i].datasets.length(); j++)
             {
-                night_flag.append(static_cast<int8_t>((df->processing_flags[i] & BathyParameters::NIGHT_FLAG) != 0));
+                datasets.add(beams[i].datasets[j]);
             }
-            add_variable(datasets, "night_flag", &night_flag);
-            add_attribute(datasets, "contentType", "modelResult");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "The solar elevation was less than 5 degrees at the time and location of the photon");
-            add_attribute(datasets, "long_name", "Night flag");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "boolean");
-            add_attribute(datasets, "flag_meanings", "false, true");
-            add_attribute(datasets, "flag_values", "0, 1");
-            goto_parent(datasets);
-
-            /* Create Variable - ortho_h */
-            add_variable(datasets, "ortho_h", &df->geoid_corr_h);
-            add_attribute(datasets, "contentType", "physicalMeasurement");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "Height of each received photon, relative to the geoid.");
-            add_attribute(datasets, "long_name", "Orthometric height");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "meters");
-            goto_parent(datasets);
-
-            /* Create Variable - sigma_thu */
-            FieldColumn<float>* sigma_thu = reinterpret_cast<FieldColumn<float>*>(df->getColumn("sigma_thu"));
-            add_variable(datasets, "sigma_thu", sigma_thu);
-            add_attribute(datasets, "contentType", "physicalMeasurement");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "The combination of the aerial and subaqueous horizontal uncertainty for each received photon");
-            add_attribute(datasets, "long_name", "Total horizontal uncertainty");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "meters");
-            goto_parent(datasets);
-
-            /* Create Variable - sigma_tvu */
-            FieldColumn<float>* sigma_tvu = reinterpret_cast<FieldColumn<float>*>(df->getColumn("sigma_tvu"));
-            add_variable(datasets, "sigma_tvu", sigma_tvu);
-            add_attribute(datasets, "contentType", "modelResult");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "The combination of the aerial and subaqueous vertical uncertainty for each received photon");
-            add_attribute(datasets, "long_name", "Total vertical uncertainty");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "meters");
-            goto_parent(datasets);
-
-            /* Create Variable - surface_h */
-            FieldColumn<float>* surface_h = reinterpret_cast<FieldColumn<float>*>(df->getColumn("surface_h"));
-            add_variable(datasets, "surface_h", surface_h);
-            add_attribute(datasets, "contentType", "modelResult");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "The geoid corrected height of the sea surface at the detected photon");
-            add_attribute(datasets, "long_name", "Sea surface orthometric height");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "meters");
-            goto_parent(datasets);
-
-            /* Create Variable - x_atc */
-            add_variable(datasets, "x_atc", &df->x_atc);
-            add_attribute(datasets, "contentType", "modelResult");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "Along-track distance in a segment projected to the ellipsoid of the received photon, based on the Along-Track Segment algorithm.  Total along track distance can be found by adding this value to the sum of segment lengths measured from the start of the most recent reference groundtrack.");
-            add_attribute(datasets, "long_name", "Distance from equator crossing");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "meters");
-            goto_parent(datasets);
-
-            /* Create Variable - y_atc */
-            add_variable(datasets, "y_atc", &df->y_atc);
-            add_attribute(datasets, "contentType", "modelResult");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "Across-track distance projected to the ellipsoid of the received photon from the reference ground track.  This is based on the Along-Track Segment algorithm described in Section 3.1 of the ATBD.");
-            add_attribute(datasets, "long_name", "Distance off RGT");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "meters");
-            goto_parent(datasets);
-
-            /* Create Variable - kd */
-            FieldColumn<float>* kd = reinterpret_cast<FieldColumn<float>*>(df->getColumn("kd"));
-            add_variable(datasets, "kd", kd);
-            add_attribute(datasets, "contentType", "modelResult");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "Turbidity of water column calculated using only ICESat-2 photons");
-            add_attribute(datasets, "long_name", "Turbidity");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "meters");
-            goto_parent(datasets);
-
-            /* Create Variable - surface_roughness */
-            FieldColumn<float>* surface_roughness = reinterpret_cast<FieldColumn<float>*>(df->getColumn("surface_roughness"));
-            add_variable(datasets, "surface_roughness", kd);
-            add_attribute(datasets, "contentType", "modelResult");
-            add_attribute(datasets, "coordinates", "delta_time lat_ph lon_ph");
-            add_attribute(datasets, "description", "Measure of wave heights and proxy for wind speed in uncertainty calculation");
-            add_attribute(datasets, "long_name", "Surface Roughness");
-            add_attribute(datasets, "source", "ATL03");
-            add_attribute(datasets, "units", "meters");
-            goto_parent(datasets);
-
-            /* Go Back to Parent Group */
-            goto_parent(datasets);
+            borrowed.insert(beams[i].borrowed.begin(), beams[i].borrowed.end());
+            if(!beams[i].error.empty()) beam_error = beams[i].error;
         }
+        if(!beam_error.empty()) throw RunTimeException(CRITICAL, RTE_FAILURE, "Failed to prepare beam group: %s", beam_error.c_str());
 
         /* Check For At Least One Beam */
         if(last_df == NULL) throw RunTimeException(CRITICAL, RTE_FAILURE, "Attempted to write ATL24 file with no beams");
@@ -834,6 +919,28 @@ int Atl24Writer::luaWriteFile(lua_State* L)
         add_attribute(datasets, "units", "json");
         goto_parent(datasets);
 
+        /* Create Variable - stats (only when the beams were run through atl24.stats) */
+        string stats_json;
+        for(int i = 0; i < NUM_BEAMS; i++)
+        {
+            BathyDataFrame* df = lua_obj->dataframes[i];
+            if(!df) continue;
+            const FieldElement<string>* beam_stats = dynamic_cast<const FieldElement<string>*>(df->getMetaData("stats", Field::ELEMENT, true));
+            if(!beam_stats) continue;
+            stats_json += FString("%s\"%s\":%s", stats_json.empty() ? "{" : ",", BEAMS[i], beam_stats->value.c_str()).c_str();
+        }
+        FieldElement<string> stats_metadata(stats_json.empty() ? "" : stats_json + "}");
+        if(!stats_json.empty())
+        {
+            add_scalar(datasets, "stats", &stats_metadata);
+            add_attribute(datasets, "contentType", "auxiliaryInformation");
+            add_attribute(datasets, "description", "per beam photon counts, depth statistics, depth histogram and footprint");
+            add_attribute(datasets, "long_name", "Beam Statistics");
+            add_attribute(datasets, "source", "Derived");
+            add_attribute(datasets, "units", "json");
+            goto_parent(datasets);
+        }
+
         /* Create Group - DatasetIdentification */
         TimeLib::gmt_time_t gmt = TimeLib::gmttime();
         TimeLib::date_t date = TimeLib::gmt2date(gmt);
@@ -869,7 +976,9 @@ int Atl24Writer::luaWriteFile(lua_State* L)
         /* Write HDF5 File */
         /*******************/
         mlog(INFO, "Writing HDF5 file: %s", filename);
-        status = HdfLib::write(filename, datasets);
+        const double write_start = TimeLib::latchtime();
+        status = Atl24Compression::write(filename, datasets, lua_obj->compression);
+        mlog(INFO, "Wrote HDF5 file %s in %.3lf seconds", filename, TimeLib::latchtime() - write_start);
     }
     catch(const RunTimeException& e)
     {
@@ -878,9 +987,24 @@ int Atl24Writer::luaWriteFile(lua_State* L)
     }
 
     /* Clean Up */
+    for(int i = 0; i < NUM_BEAMS; i++)
+    {
+        if(threads[i])
+        {
+            delete threads[i]; // joins
+            for(int j = 0; j < beams[i].datasets.length(); j++)
+            {
+                datasets.add(beams[i].datasets[j]);
+            }
+            borrowed.insert(beams[i].borrowed.begin(), beams[i].borrowed.end());
+        }
+    }
     for(int i = 0; i < datasets.length(); i++)
     {
-        delete [] datasets[i].data;
+        if(borrowed.find(datasets[i].data) == borrowed.end())
+        {
+            delete [] datasets[i].data;
+        }
     }
 
     /* Return */
@@ -36,14 +36,18 @@
  * INCLUDES
  ******************************************************************************/
 
+#include <set>
+
 #include "OsApi.h"
 #include "EventLib.h"
+#include "List.h"
 #include "LuaObject.h"
 #include "HdfLib.h"
 #include "FieldElement.h"
 #include "Icesat2Parameters.h"
 #include "BathyDataFrame.h"
 #include "Atl03Granule.h"
+#include "Atl24Compression.h"
 
 /******************************************************************************
  * CLASS DECLARATION
@@ -68,6 +72,15 @@ class Atl24Writer: public LuaObject
          * Typedefs
          *--------------------------------------------------------------------*/
 
+        typedef struct {
+            BathyDataFrame*             df;
+            const char*                 beam;
+            bool                        release;
+            List<HdfLib::dataset_t>     datasets;
+            std::set<const uint8_t*>    borrowed;
+            string                      error;
+        } beam_work_t;
+
         /*--------------------------------------------------------------------
          * Methods
          *--------------------------------------------------------------------*/
@@ -82,10 +95,11 @@ class Atl24Writer: public LuaObject
          * Methods
          *--------------------------------------------------------------------*/
 
-        Atl24Writer  (lua_State* L, Icesat2Parameters* _parms, BathyDataFrame** _dataframes, Atl03Granule* _granule, const char* _release);
+        Atl24Writer  (lua_State* L, Icesat2Parameters* _parms, BathyDataFrame** _dataframes, Atl03Granule* _granule, const char* _release, bool _streaming, const Atl24Compression::parms_t& _compression);
         ~Atl24Writer (void) override;
 
-        static int luaWriteFile (lua_State* L);
+        static int  luaWriteFile    (lua_State* L);
+        static void* prepareBeam    (void* parm);
 
         /*--------------------------------------------------------------------
          * Data
@@ -96,6 +110,8 @@ class Atl24Writer: public LuaObject
         Icesat2Parameters* parms;
         BathyDataFrame* dataframes[NUM_BEAMS];
         Atl03Granule* granule;
+        bool streaming; // release dataframe columns as they are staged for writing
+        Atl24Compression::parms_t compression; // dataset chunking and filters
 };
 
 #endif  /* __atl24_writer__ */
@@ -44,6 +44,8 @@
 #include "BlunderRunner.h"
 #include "Icesat2Parameters.h"
 #include "Atl24DataFrame.h"
+#include "Atl24Photons.h"
+#include "Atl24Arena.h"
 
 using namespace ATL24::cleanup;
 using namespace ATL24::photon;
@@ -109,18 +111,24 @@ bool BlunderRunner::run (GeoDataFrame* dataframe)
     Atl24DataFrame& df = *dynamic_cast<Atl24DataFrame*>(dataframe);
 
     // convert dataframe to input structure of ATL24 v2 cleanup algorithm
-    vector<Photon> p(df.length());
-    for(size_t i = 0; i < static_cast<size_t>(df.length()); ++i)
+    Atl24Arena* arena = Atl24Arena::acquire(df.length());
+    vector<Photon>& p = arena->photons;
+    Atl24Photons::fromAtl24(df, p);
+
+    // execute ATL24 v2 cleanup algorithm
+    vector<size_t> q;
+    try
     {
-        // only the below members of the structure are used
-        p[i].x_atc = df.x_atc[i];
-        p[i].h_ph = df.ortho_h[i];
-        p[i].class_ph = df.class_ph[i];
+        Params params;
+        q = do_cleanup(p, params);
     }
+    catch(const std::exception& e)
+    {
+        status = false;
+        mlog(CRITICAL, "Failed to run cleanup on %ld photons: %s", df.length(), e.what());
+    }
+    Atl24Arena::release(arena);
 
-    // execute ATL24 v2 cleanup algorithm
-    Params params;
-    const vector<size_t> q = do_cleanup(p, params);
     for(size_t i: q)
     {
         // check valid photon
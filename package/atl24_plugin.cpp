@@ -36,7 +36,14 @@
 #include "LuaEngine.h"
 #include "Atl03Granule.h"
 
+#include "Atl24Arena.h"
+#include "Atl24Capture.h"
+#include "Atl24Cache.h"
+#include "Atl24Model.h"
+#include "Atl24Reprocess.h"
 #include "Atl24Runner.h"
+#include "Atl24Scheduler.h"
+#include "Atl24Stats.h"
 #include "Atl24Uncertainty.h"
 #include "Atl24Writer.h"
 #include "BlunderRunner.h"
@@ -90,7 +97,14 @@ int atl24_open (lua_State *L)
         {"classifier",      Atl24Runner::luaCreate},
         {"writer",          Atl24Writer::luaCreate},
         {"uncertainty",     Atl24Uncertainty::luaCreate},
+        {"reprocess",       Atl24Reprocess::luaCreate},
+        {"stats",           Atl24Stats::luaCreate},
         {"atl03granule",    Atl03Granule::luaCreate},
+        {"modelstats",      Atl24Model::luaStats},
+        {"scheduler",       Atl24Scheduler::luaConfig},
+        {"capture",         Atl24Capture::luaCapture},
+        {"arena",           Atl24Arena::luaStats},
+        {"cache",           Atl24Cache::luaCache},
         {NULL,              NULL}
     };
 
@@ -107,6 +121,9 @@ extern "C" {
 void initatl24 (void)
 {
     /* Initialize Modules */
+    Atl24Model::init();
+    Atl24Arena::init();
+    Atl24Scheduler::init();
     Atl24Uncertainty::init();
     Atl24Writer::init();
 
@@ -119,5 +136,8 @@ void initatl24 (void)
 
 void deinitatl24 (void)
 {
+    /* Release Shared Models */
+    Atl24Model::deinit();
+    Atl24Arena::deinit();
 }
 }
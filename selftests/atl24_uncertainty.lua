@@ -121,6 +121,48 @@ runner.unittest("ATL24 Uncertainty Tables", function()
 
 end)
 
+-- Self Test --
+
+runner.unittest("ATL24 Uncertainty Fast Path", function()
+
+    local rqst          = {}
+    local timeout       = 60 * 1000
+    local resource      = "local"
+    local parms         = bathy.parms(rqst, nil, "icesat2", resource)
+    local outputs       = {}
+
+    for _,fast_path in ipairs({false, true}) do
+        local uncertainty = atl24.uncertainty(parms, fast_path)
+        local df = core.dataframe({
+            surface_h           = {-3.0, -0.5, 0.0, 0.5, 2.0, 7.5, 15.0, 25.0},
+            kd                  = {0.05, 0.10, 0.15, 0.20, 0.25, 0.30, 0.35, 0.40},
+            surface_roughness   = {1, 2, 3, 4, 5, 6, 7, 8},
+            ref_el              = {d2r(1), d2r(1), d2r(2), d2r(2), d2r(3), d2r(3), d2r(4), d2r(4)},
+            geoid_corr_h        = {0, 0, 0, 0, 0, 0, 0, 0},
+            sigma_h             = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8},
+            sigma_along         = {2.1, 2.2, 2.3, 2.4, 2.5, 2.6, 2.7, 2.8},
+            sigma_across        = {3.1, 3.2, 3.3, 3.4, 3.5, 3.6, 3.7, 3.8}
+        }, {
+            spot = 0,
+            granule = resource
+        })
+
+        df:run(uncertainty)
+        df:run(core.TERMINATE)
+
+        runner.assert(df:start(), "failed to start dataframe processing", true)
+        runner.assert(df:finished(timeout), "failed to finish dataframe processing", true)
+
+        table.insert(outputs, df:export()["gdf"])
+    end
+
+    for i = 1,8 do
+        runner.assert(outputs[1]["sigma_tvu"][i] == outputs[2]["sigma_tvu"][i], string.format("tvu mismatch - %d: %f ~= %f", i, outputs[1]["sigma_tvu"][i], outputs[2]["sigma_tvu"][i]))
+        runner.assert(outputs[1]["sigma_thu"][i] == outputs[2]["sigma_thu"][i], string.format("thu mismatch - %d: %f ~= %f", i, outputs[1]["sigma_thu"][i], outputs[2]["sigma_thu"][i]))
+    end
+
+end)
+
 -- Report Results --
 
 runner.report()
@@ -60,6 +60,12 @@ runner.unittest("ATL24 HDF5 Writer", function()
     local atl24_file = atl24.writer(parms, dataframes, granule, "X")
     runner.assert(atl24_file:write("/tmp/atl24.h5"))
 
+    -- rerun uncertainty on written file
+    local reprocess = atl24.reprocess(atl03h5)
+    local status, num_updated = reprocess:update("/tmp/atl24.h5")
+    runner.assert(status, "failed to update uncertainty")
+    runner.assert(num_updated == #parms["beams"], string.format("updated %d beams", num_updated))
+
 end)
 
 -- Report Results --
@@ -4,151 +4,245 @@ local aws_utils     = require("aws_utils")
 local _, build      = sys.version()
 local release       = "3"
 local timeout       = 5400 * 1000
-local result        = { status = true, build = build, start = time.latch(), messages = {} }
+local compression   = nil -- h5 dataset layout, e.g. {chunk_size=100000, shuffle=true, deflate=4} (set per request by "compression", see below)
+local prefetch      = 1 -- granules whose ATL03 beams are read while the current granule is classified and written
+local cache_dir     = nil -- directory of classifier results reused when a granule is reprocessed, e.g. "/data/atl24cache"
+local result        = { status = true, build = build, start = time.latch(), messages = {}, timing = {}, granules = {} }
 local consoleq      = msg.subscribe("consoleq") -- prevents error posting to consoleq
 
-repeat
+-- objects shared by every granule in the batch (created with the first granule);
+-- the classifier is not shared since it carries the granule's deadline
+local shared        = nil
 
-    -- check global arguments
-    if not Arguments then
-        table.insert(result["messages"], "no argument supplied")
-        result["status"] = false
-        break
-    end
+-- start processing a granule: creates its beam dataframes, which begin reading
+-- ATL03 immediately and run the algorithms as soon as their photons are read
+local function start_granule(resource, index)
 
-    -- status arguments
-    local resource = Arguments:match("([^,]+)")
-    if not resource then
-        table.insert(result["messages"], "failed to get arguments")
-        result["status"] = false
-        break
-    else
-        table.insert(result["messages"], string.format("processing resource=%s, timeout=%d ms", resource, timeout))
-    end
+    local granule_result = { status = true, start = time.latch(), messages = {}, timing = {} }
+    local ctx = { resource = resource, result = granule_result }
+    result["granules"][resource] = granule_result
+    table.insert(granule_result["messages"], string.format("processing resource=%s, timeout=%d ms", resource, timeout))
 
     -- output files
-    local parquet_output_file = resource:gsub("ATL03", string.format("atl24r%s/parquet/ATL24", release)):gsub("%.h5", string.format("_00%s_01.parquet", release))
-    local h5_output_file = resource:gsub("ATL03", string.format("atl24r%s/h5/ATL24", release)):gsub("%.h5", string.format("_00%s_01.h5", release))
+    ctx.parquet_output_file = resource:gsub("ATL03", string.format("atl24r%s/parquet/ATL24", release)):gsub("%.h5", string.format("_00%s_01.parquet", release))
+    ctx.h5_output_file = resource:gsub("ATL03", string.format("atl24r%s/h5/ATL24", release)):gsub("%.h5", string.format("_00%s_01.h5", release))
 
     -- request structure
     local rqst = {
+        ["node_timeout"] = timeout // 1000, -- also the classifier's deadline
         ["output"] = {
             ["asset"] = "sliderule-stage",
             ["format"] = "geoparquet",
-            ["path"] = parquet_output_file,
+            ["path"] = ctx.parquet_output_file,
             ["with_checksum"] = true
         }
     }
 
-    -- wait for NSIDC credentials
-    if not aws_utils.wait_credentials("nsidc-cloud") then
-        table.insert(result["messages"], "failed to get NSIDC credentials")
-        result["status"] = false
-        break
-    end
-
     -- create objects used in processing granule
-    local parms         = bathy.parms(rqst, nil, "icesat2", resource)
-    local bathymask     = bathy.mask()
-    local atl03h5       = h5coro.object(parms["asset"], resource)
-    local granule       = icesat2.atl03granule(parms, atl03h5, "consoleq")
-    local classifier    = atl24.classifier(parms)
-    local refractor     = bathy.refraction(parms)
-    local uncertainty   = atl24.uncertainty(parms)
-    local sender        = core.framesender(parms, "rspq")
-    local dataframe     = core.dataframe({}, {granule=resource, request=json.encode(rqst)})
-    local dataframes    = {} -- holds beam dataframes
+    ctx.parms           = bathy.parms(rqst, nil, "icesat2", resource)
+    if not shared then
+        shared = {
+            bathymask   = bathy.mask(),
+            refractor   = bathy.refraction(ctx.parms),
+            uncertainty = atl24.uncertainty(ctx.parms),
+            stats       = atl24.stats(ctx.parms)
+        }
+    end
+    ctx.classifier      = atl24.classifier(ctx.parms) -- per granule, so its deadline does not move while an earlier granule's beams classify
+    ctx.classifier:deadline(ctx.parms["node_timeout"] * 1000) -- beams still classifying when the granule times out are cancelled
+    ctx.rspq            = string.format("rspq%d", index) -- each granule collects its beams on its own queue
+    ctx.atl03h5         = h5coro.object(ctx.parms["asset"], resource)
+    ctx.granule         = icesat2.atl03granule(ctx.parms, ctx.atl03h5, "consoleq")
+    ctx.sender          = core.framesender(ctx.parms, ctx.rspq)
+    ctx.dataframe       = core.dataframe({}, {granule=resource, request=json.encode(rqst)})
+    ctx.dataframes      = {} -- holds beam dataframes
 
     -- build final dataframe from beam dataframes
-    dataframe:receive("rspq", "consoleq", 6, timeout)
-    for _, beam in ipairs(parms["beams"]) do
-        local df = bathy.dataframe(beam, parms, bathymask, atl03h5, "consoleq")
+    ctx.dataframe:receive(ctx.rspq, "consoleq", 6, timeout)
+    for _, beam in ipairs(ctx.parms["beams"]) do
+        local df = bathy.dataframe(beam, ctx.parms, shared.bathymask, ctx.atl03h5, "consoleq")
         if df then
-            df:run(classifier)
-            df:run(refractor)
-            df:run(uncertainty)
-            df:run(sender)
+            df:run(ctx.classifier)
+            df:run(shared.refractor)
+            df:run(shared.uncertainty)
+            df:run(shared.stats)
+            df:run(ctx.sender)
             df:run(core.TERMINATE)
-            dataframes[beam] = df
+            ctx.dataframes[beam] = df
         else
-            table.insert(result["messages"], string.format("failed to create dataframe for beam %s", beam))
+            table.insert(granule_result["messages"], string.format("failed to create dataframe for beam %s", beam))
         end
     end
 
-    -- wait for data to finish being read and deduplicated
-    for beam, df in pairs(dataframes) do
-        sys.log(core.CRITICAL, string.format("waiting for beam %s", beam))
-        local status = df:finished(timeout)
-        if status then
-            table.insert(result["messages"], string.format("finished dataframe for beam %s", beam))
-        else
-            table.insert(result["messages"], string.format("failed to finish dataframe for beam %s", beam))
+    return ctx
+end
+
+-- finish processing a granule: waits for its beams, then writes and sends its outputs
+local function finish_granule(ctx)
+
+    local granule_result = ctx.result
+
+    repeat
+
+        -- wait for data to finish being read and deduplicated
+        for beam, df in pairs(ctx.dataframes) do
+            sys.log(core.CRITICAL, string.format("waiting for beam %s of %s", beam, ctx.resource))
+            local status = df:finished(timeout)
+            if status then
+                table.insert(granule_result["messages"], string.format("finished dataframe for beam %s", beam))
+                local timing = {}
+                for _, name in ipairs({"queue_wait", "threads", "cached", "cancelled", "time_photons", "time_classify", "time_elevations", "time_kd", "time_roughness", "time_columns", "time_run", "photon_rate"}) do
+                    timing[name] = df:meta(name)
+                end
+                granule_result["timing"][beam] = timing
+                if timing["cancelled"] == 1 then
+                    table.insert(granule_result["messages"], string.format("classifier cancelled for beam %s", beam))
+                end
+            else
+                table.insert(granule_result["messages"], string.format("failed to finish dataframe for beam %s", beam))
+            end
         end
-    end
 
-    -- send termination signal to final dataframe
-    local rspq = msg.publish("rspq")
-    rspq:sendstring("")
+        -- send termination signal to final dataframe
+        local rspq = msg.publish(ctx.rspq)
+        rspq:sendstring("")
 
-    -- wait for final dataframe (blocks until dataframe complete or timeout)
-    if not dataframe:waiton(timeout) then
-        table.insert(result["messages"], "failed to receive proxied dataframe")
-        result["status"] = false
-        break
-    end
+        -- wait for final dataframe (blocks until dataframe complete or timeout)
+        if not ctx.dataframe:waiton(timeout) then
+            table.insert(granule_result["messages"], "failed to receive proxied dataframe")
+            granule_result["status"] = false
+            break
+        end
+
+        -- check dataFrame constraints
+        sys.log(core.CRITICAL, string.format("constructed final dataframe for %s with %d rows, and %d columns", ctx.resource, ctx.dataframe:numrows(), ctx.dataframe:numcols()))
+        if ctx.dataframe:numrows() <= 0 or ctx.dataframe:numcols() <= 0 then
+            table.insert(granule_result["messages"], "produced an empty dataframe")
+            granule_result["status"] = false
+            break
+        end
+
+        -- create arrow dataFrame
+        local arrow_dataframe = arrow.dataframe(ctx.parms, ctx.dataframe)
+        if not arrow_dataframe then
+            table.insert(granule_result["messages"], "failed to create arrow dataframe")
+            granule_result["status"] = false
+            break
+        end
 
-    -- check dataFrame constraints
-    sys.log(core.CRITICAL, string.format("constructed final dataframe with %d rows, and %d columns", dataframe:numrows(), dataframe:numcols()))
-    if dataframe:numrows() <= 0 or dataframe:numcols() <= 0 then
-        table.insert(result["messages"], "produced an empty dataframe")
+        -- write dataFrame to parquet file
+        local arrow_filename = arrow_dataframe:export()
+        if not arrow_filename then
+            table.insert(granule_result["messages"], "failed to write dataframe to parquet file")
+            granule_result["status"] = false
+            break
+        end
+
+        -- send parquet file to s3
+        local parquet_status = core.send2user(arrow_filename, "consoleq", ctx.parms, ctx.parquet_output_file)
+        if not parquet_status then
+            table.insert(granule_result["messages"], "failed to send parquet file")
+            granule_result["status"] = false
+            break
+        end
+
+        -- write dataframes to h5 file
+        local tmp_filename = string.format("/tmp/%s", ctx.resource:gsub("ATL03", "TMP"):gsub("%.h5", ".bin"))
+        local atl24_file = atl24.writer(ctx.parms, ctx.dataframes, ctx.granule, release, true, compression) -- streaming: beam dataframes are not used after writing
+        local write_status = atl24_file:write(tmp_filename)
+        if not write_status then
+            table.insert(granule_result["messages"], "failed to write h5 file")
+            granule_result["status"] = false
+            break
+        end
+
+        -- send h5 file to s3
+        local h5_status = core.send2user(tmp_filename, "consoleq", ctx.parms, ctx.h5_output_file)
+        if not h5_status then
+            table.insert(granule_result["messages"], "failed to send h5 file")
+            granule_result["status"] = false
+            break
+        end
+
+    until true
+
+    granule_result["stop"] = time.latch()
+end
+
+repeat
+
+    -- check global arguments
+    if not Arguments then
+        table.insert(result["messages"], "no argument supplied")
         result["status"] = false
         break
     end
 
-    -- create arrow dataFrame
-    local arrow_dataframe = arrow.dataframe(parms, dataframe)
-    if not arrow_dataframe then
-        table.insert(result["messages"], "failed to create arrow dataframe")
+    -- status arguments (a comma separated list of resources runs as one batch), or a json request
+    -- {"resources": "<comma separated list>", "compression": {"chunk_size": ..., "shuffle": ..., "deflate": ..., "zstd": ...}}
+    local resource_list = Arguments
+    if Arguments:sub(1, 1) == "{" then
+        local decoded, request = pcall(json.decode, Arguments)
+        if not decoded then
+            table.insert(result["messages"], "failed to decode request")
+            result["status"] = false
+            break
+        end
+        resource_list = request["resources"] or ""
+        compression = request["compression"] or compression
+    end
+    local resources = {}
+    for resource in resource_list:gmatch("([^,]+)") do
+        table.insert(resources, resource)
+    end
+    if #resources == 0 then
+        table.insert(result["messages"], "failed to get arguments")
         result["status"] = false
         break
+    else
+        table.insert(result["messages"], string.format("processing %d resource(s), prefetch=%d", #resources, prefetch))
     end
 
-    -- write dataFrame to parquet file
-    local arrow_filename = arrow_dataframe:export()
-    if not arrow_filename then
-        table.insert(result["messages"], "failed to write dataframe to parquet file")
+    -- wait for NSIDC credentials
+    if not aws_utils.wait_credentials("nsidc-cloud") then
+        table.insert(result["messages"], "failed to get NSIDC credentials")
         result["status"] = false
         break
     end
 
-    -- send parquet file to s3
-    local parquet_status = core.send2user(arrow_filename, "consoleq", parms, parquet_output_file)
-    if not parquet_status then
-        table.insert(result["messages"], "failed to send parquet file")
-        result["status"] = false
-        break
+    -- reuse classifier results of earlier runs
+    if cache_dir then
+        atl24.cache(cache_dir)
     end
 
-    -- write dataframes to h5 file
-    local tmp_filename = string.format("/tmp/%s", resource:gsub("ATL03", "TMP"):gsub("%.h5", ".bin"))
-    local atl24_file = atl24.writer(parms, dataframes, granule, release)
-    local write_status = atl24_file:write(tmp_filename)
-    if not write_status then
-        table.insert(result["messages"], "failed to write h5 file")
-        result["status"] = false
-        break
+    -- process granules in order, keeping the next ones reading while the current one finishes
+    local in_flight = {}
+    local next_index = 1
+    while next_index <= #resources or #in_flight > 0 do
+        while next_index <= #resources and #in_flight <= prefetch do
+            table.insert(in_flight, start_granule(resources[next_index], next_index))
+            next_index = next_index + 1
+        end
+        local ctx = table.remove(in_flight, 1)
+        finish_granule(ctx)
+        if not ctx.result["status"] then
+            result["status"] = false
+        end
+        ctx = nil
+        collectgarbage() -- releases the beam dataframes of the finished granule
     end
 
-    -- send h5 file to s3
-    local h5_status = core.send2user(tmp_filename, "consoleq", parms, h5_output_file)
-    if not h5_status then
-        table.insert(result["messages"], "failed to send h5 file")
-        result["status"] = false
-        break
+    -- single granule runs keep the original result layout
+    if #resources == 1 then
+        local granule_result = result["granules"][resources[1]]
+        for _, message in ipairs(granule_result["messages"]) do
+            table.insert(result["messages"], message)
+        end
+        result["timing"] = granule_result["timing"]
     end
 
 until true
 
 -- return results
 result["stop"] = time.latch()
-return json.encode(result), true
\ No newline at end of file
+return json.encode(result), true
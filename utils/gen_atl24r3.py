@@ -23,6 +23,8 @@ parser.add_argument('--rerun',      type=str,               default=None) # name
 parser.add_argument('--vcpus',      type=int,               default=4)
 parser.add_argument('--memory',     type=int,               default=16000)
 parser.add_argument('--batch_size', type=int,               default=10000)
+parser.add_argument('--granules_per_job', type=int,         default=1) # granules processed back to back by one runner
+parser.add_argument('--compression', type=str,              default=None) # h5 dataset layout as json, e.g. '{"chunk_size": 100000, "shuffle": true, "deflate": 4}'
 parser.add_argument('--script',     type=str,               default="utils/gen_atl24r3.lua")
 parser.add_argument('--database',   type=str,               default="data/atl24r3_database.json")
 parser.add_argument('--vset',       type=str,               default="data/atl24r3_validation_set.txt")
@@ -90,18 +92,21 @@ def submit_job(name, granules):
             unique = ''.join(random.choices(string.ascii_lowercase, k=3))
             name = f"{name}_{unique}_{i}"
 
-        # submit job
-        args_list = granules[i:i+args.batch_size]
+        # submit job (each entry is a comma separated list of granules run as one batch)
+        batch = granules[i:i+args.batch_size]
+        args_list = [','.join(batch[j:j+args.granules_per_job]) for j in range(0, len(batch), args.granules_per_job)]
+        if args.compression:
+            args_list = [json.dumps({"resources": entry, "compression": json.loads(args.compression)}) for entry in args_list]
         lua_script = open(args.script, "r").read()
         rsps = session.runner.submit(name=name, script=lua_script, args=args_list, optional_args={"vcpus":args.vcpus, "memory":args.memory})
-        print(f"Submitted job {name} using script {args.script} with {len(args_list)} entries")
+        print(f"Submitted job {name} using script {args.script} with {len(args_list)} entries covering {len(batch)} granules")
 
         # save job
         database["submissions"][name] = rsps | {"complete": False}
         print(f"Saved job submission", rsps)
 
         # save granules
-        for granule in args_list:
+        for granule in batch:
             database["granules"][granule] = {"name": name, "status": "pending"}
 
 #########################################
@@ -175,18 +180,23 @@ if args.status:
         prefix = "/".join(run_url.split("s3://")[-1].split("/")[1:])
         rsps = load_remote_file(bucket, f"{prefix}/receipt.json") # {"name": ..., "username": ... "args": <path to arg file>, "environment": ...}
         args_list = load_remote_file(bucket, rsps["args"])
-        for i in tqdm(range(len(args_list)), total=len(args_list), desc=f"{run_url}", unit="granule"):
+        for i in tqdm(range(len(args_list)), total=len(args_list), desc=f"{run_url}", unit="job"):
+            entry = args_list[i]
+            if entry.startswith("{"): # submitted with --compression
+                entry = json.loads(entry)["resources"]
+            entry_granules = entry.split(",")
             try:
                 rsps = load_remote_file(bucket, f"{prefix}/result{i}.json")
-                result = {
-                    "status": rsps["status"] and "output" or "empty",
-                    "duration": rsps["status"] and (rsps["stop"] - rsps["start"]) or 0.0,
-                    "rsps": rsps
-                }
+                for granule in entry_granules:
+                    granule_rsps = rsps.get("granules", {}).get(granule, rsps) if len(entry_granules) > 1 else rsps
+                    results[granule] = {
+                        "status": granule_rsps["status"] and "output" or "empty",
+                        "duration": granule_rsps["status"] and (granule_rsps["stop"] - granule_rsps["start"]) or 0.0,
+                        "rsps": granule_rsps
+                    }
             except Exception as e:
-                result = {"status": "error"}
-            granule = args_list[i]
-            results[granule] = result
+                for granule in entry_granules:
+                    results[granule] = {"status": "error"}
         return results
 
     # get status
@@ -0,0 +1,112 @@
+-- initialization
+local json          = require("json")
+local aws_utils     = require("aws_utils")
+local _, build      = sys.version()
+local release       = "3"
+local timeout       = 600 -- seconds to wait for each ATL03 dataset
+local stage_bucket  = "sliderule-stage" -- bucket holding the granules written by gen_atl24r3.lua
+local stage_region  = "us-west-2"
+local stage_identity = "iam-role"
+local result        = { status = true, build = build, start = time.latch(), messages = {}, granules = {} }
+local consoleq      = msg.subscribe("consoleq") -- prevents error posting to consoleq
+
+-- rerun the uncertainty calculation on an existing ATL24 granule: only the
+-- sigma_thu and sigma_tvu datasets are rewritten, classification is reused
+local function update_granule(resource)
+
+    local granule_result = { status = true, start = time.latch(), messages = {} }
+    result["granules"][resource] = granule_result
+
+    -- local copy of the granule, removed on every path out of the update
+    local tmp_filename = string.format("/tmp/%s", resource:gsub("ATL03", "TMP"):gsub("%.h5", ".h5"))
+
+    repeat
+
+        -- existing granule
+        local h5_output_file = resource:gsub("ATL03", string.format("atl24r%s/h5/ATL24", release)):gsub("%.h5", string.format("_00%s_01.h5", release))
+        table.insert(granule_result["messages"], string.format("updating %s", h5_output_file))
+
+        -- request structure
+        local rqst = {
+            ["output"] = {
+                ["asset"] = "sliderule-stage",
+                ["path"] = h5_output_file
+            }
+        }
+
+        -- download existing granule
+        if not aws.s3download(stage_bucket, h5_output_file, stage_region, stage_identity, tmp_filename) then
+            table.insert(granule_result["messages"], "failed to download h5 file")
+            granule_result["status"] = false
+            break
+        end
+
+        -- rerun uncertainty
+        local parms = bathy.parms(rqst, nil, "icesat2", resource)
+        local atl03h5 = h5coro.object(parms["asset"], resource)
+        local reprocess = atl24.reprocess(atl03h5, nil, timeout)
+        local status, num_updated = reprocess:update(tmp_filename)
+        table.insert(granule_result["messages"], string.format("updated %d beams", num_updated))
+        if not status then
+            table.insert(granule_result["messages"], "failed to update uncertainty")
+            granule_result["status"] = false
+            break
+        end
+
+        -- send h5 file back to s3
+        if not core.send2user(tmp_filename, "consoleq", parms, h5_output_file) then
+            table.insert(granule_result["messages"], "failed to send h5 file")
+            granule_result["status"] = false
+            break
+        end
+
+    until true
+
+    -- clean up (a partial download is removed too, a missing file is ignored)
+    os.remove(tmp_filename)
+
+    granule_result["stop"] = time.latch()
+end
+
+repeat
+
+    -- check global arguments
+    if not Arguments then
+        table.insert(result["messages"], "no argument supplied")
+        result["status"] = false
+        break
+    end
+
+    -- status arguments (a comma separated list of resources runs as one batch)
+    local resources = {}
+    for resource in Arguments:gmatch("([^,]+)") do
+        table.insert(resources, resource)
+    end
+    if #resources == 0 then
+        table.insert(result["messages"], "failed to get arguments")
+        result["status"] = false
+        break
+    else
+        table.insert(result["messages"], string.format("updating uncertainty of %d resource(s)", #resources))
+    end
+
+    -- wait for NSIDC credentials
+    if not aws_utils.wait_credentials("nsidc-cloud") then
+        table.insert(result["messages"], "failed to get NSIDC credentials")
+        result["status"] = false
+        break
+    end
+
+    -- update granules in order
+    for _, resource in ipairs(resources) do
+        update_granule(resource)
+        if not result["granules"][resource]["status"] then
+            result["status"] = false
+        end
+    end
+
+until true
+
+-- return results
+result["stop"] = time.latch()
+return json.encode(result), true
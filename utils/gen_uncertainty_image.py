@@ -0,0 +1,58 @@
+#
+# Writes the SNR, THU and Transport lookup tables into the binary image that
+# the plugin loads in place of its compiled in tables when the image is
+# installed as <CONFDIR>/atl24_uncertainty.bin
+#
+#   python utils/gen_uncertainty_image.py --tables tables --output atl24_uncertainty.bin
+#
+import argparse
+import csv
+import math
+import os
+import struct
+
+# Command Line Arguments
+parser = argparse.ArgumentParser(description="""ATL24 uncertainty table image""")
+parser.add_argument('--tables',     type=str,   default="tables") # directory of SNR/THU/Transport csv files
+parser.add_argument('--output',     type=str,   default="atl24_uncertainty.bin")
+args = parser.parse_args()
+
+# Image Layout (must match Atl24Uncertainty::loadImage)
+MAGIC = b"ATL24LUT"
+VERSION = 1
+TABLES = ["SNR", "THU", "Transport"]
+NUM_POINTING_ANGLES = 6
+NUM_TABLE_ENTRIES = 25
+JERLOV_TYPES = ["III", "IC", "3C", "5C", "7C"]
+
+# FNV-1a Hash
+def fnv1a(data):
+    h = 0xCBF29CE484222325
+    for b in data:
+        h ^= b
+        h = (h * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+# Build Image
+image = bytearray(MAGIC)
+image += struct.pack("<4I", VERSION, len(TABLES), NUM_POINTING_ANGLES, NUM_TABLE_ENTRIES)
+for table in TABLES:
+    for angle in range(NUM_POINTING_ANGLES):
+        filename = os.path.join(args.tables, f"{table}_ATLAS_{angle}_deg.csv")
+        with open(filename, newline="") as f:
+            rows = list(csv.DictReader(f))
+        if len(rows) != NUM_TABLE_ENTRIES:
+            raise RuntimeError(f"{filename} has {len(rows)} rows, expected {NUM_TABLE_ENTRIES}")
+        for i, row in enumerate(rows):
+            if row["JerlovType"] != JERLOV_TYPES[i % len(JERLOV_TYPES)]:
+                raise RuntimeError(f"{filename} row {i} has Jerlov type {row['JerlovType']}")
+            coefs = [float(row["a"]), float(row["b"]), float(row.get("c", 0.0))]
+            if not all(math.isfinite(c) for c in coefs):
+                raise RuntimeError(f"{filename} row {i} has a non-finite coefficient")
+            image += struct.pack("<i16s3d", int(row["Wind"]), row["JerlovType"].encode(), *coefs)
+image += struct.pack("<Q", fnv1a(image))
+
+# Write Image
+with open(args.output, "wb") as f:
+    f.write(image)
+print(f"Wrote {len(image)} bytes to {args.output}")
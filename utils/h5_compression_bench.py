@@ -0,0 +1,75 @@
+#
+# Reports the write time versus file size tradeoff of HDF5 chunking and
+# compression settings on a reference ATL24 granule
+#
+#   python utils/h5_compression_bench.py --granule ATL24_20241107234251_08052501_006_01_003_01.h5
+#
+import argparse
+import os
+import sys
+import time
+import h5py
+
+try:
+    import hdf5plugin # provides zstd filter
+except Exception:
+    hdf5plugin = None
+
+# Command Line Arguments
+parser = argparse.ArgumentParser(description="""ATL24 HDF5 compression benchmark""")
+parser.add_argument('--granule',        type=str,   required=True) # local path to reference ATL24 granule
+parser.add_argument('--output_dir',     type=str,   default="/tmp")
+parser.add_argument('--chunk_sizes',    type=int,   nargs='+', default=[10000, 100000, 1000000])
+parser.add_argument('--deflate_levels', type=int,   nargs='+', default=[1, 4, 6, 9])
+parser.add_argument('--zstd_levels',    type=int,   nargs='+', default=[1, 3, 9])
+parser.add_argument('--repeat',         type=int,   default=3)
+args = parser.parse_args()
+
+# Read Reference Granule
+def read_granule(filename):
+    contents = {}
+    def visitor(name, obj):
+        if isinstance(obj, h5py.Dataset):
+            contents[name] = (obj[()], dict(obj.attrs))
+    with h5py.File(filename, "r") as f:
+        f.visititems(visitor)
+    return contents
+
+# Write Granule with Settings
+def write_granule(filename, contents, chunk_size, shuffle, filters):
+    with h5py.File(filename, "w") as f:
+        for name, (data, attrs) in contents.items():
+            if chunk_size and hasattr(data, "shape") and len(data.shape) == 1 and data.shape[0] > 0:
+                dset = f.create_dataset(name, data=data, chunks=(min(chunk_size, data.shape[0]),), shuffle=shuffle, **filters)
+            else:
+                dset = f.create_dataset(name, data=data)
+            for key, value in attrs.items():
+                dset.attrs[key] = value
+
+# Build Settings - (label, chunk size, shuffle, filter arguments)
+settings = [("contiguous", 0, False, {})]
+for chunk_size in args.chunk_sizes:
+    settings.append((f"chunk={chunk_size}", chunk_size, False, {}))
+    for level in args.deflate_levels:
+        settings.append((f"chunk={chunk_size},shuffle,deflate={level}", chunk_size, True, {"compression": "gzip", "compression_opts": level}))
+    if hdf5plugin is not None:
+        for level in args.zstd_levels:
+            settings.append((f"chunk={chunk_size},shuffle,zstd={level}", chunk_size, True, dict(hdf5plugin.Zstd(clevel=level))))
+if hdf5plugin is None:
+    print("hdf5plugin unavailable, zstd settings skipped")
+
+# Run Benchmark
+contents = read_granule(args.granule)
+reference_size = os.path.getsize(args.granule)
+filename = os.path.join(args.output_dir, "atl24_compression_bench.h5")
+print(f'{"setting":<40} {"write (s)":>10} {"size (MB)":>10} {"ratio":>7}')
+for label, chunk_size, shuffle, filters in settings:
+    durations = []
+    for _ in range(args.repeat):
+        start = time.perf_counter()
+        write_granule(filename, contents, chunk_size, shuffle, filters)
+        durations.append(time.perf_counter() - start)
+    size = os.path.getsize(filename)
+    print(f'{label:<40} {min(durations):>10.3f} {size / 1e6:>10.2f} {reference_size / size:>7.2f}')
+    sys.stdout.flush()
+    os.remove(filename)